@@ -0,0 +1,85 @@
+#include <chrono>
+#include <iostream>
+
+#include "../src/arena.h"
+#include "../src/structures.h"
+#include "../tests/counting.h"
+
+using namespace std;
+
+/*
+    Cost of pending reference records taken one by one from the heap, as
+    before the arena, against records taken from a pool in the arena. Every
+    other record is dropped early, as a fixup patched when its label shows
+    up, and the rest is released at teardown: node by node from the heap,
+    all blocks together from the arena. Heap allocations of both are counted.
+*/
+
+#define RECORDS 1000000
+
+static double milliseconds(chrono::steady_clock::time_point since)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+int main()
+{
+    SymbolReference* first = nullptr;
+
+    allocations = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (size_t i = 0; i < RECORDS; i++)
+    {
+        SymbolReference* record = new SymbolReference(i, 1, i, RelocationType::R_386_16, i + 2, false);
+
+        // patched right away, its memory goes back to the heap
+        if (i % 2)
+            delete record;
+        else
+        {
+            record->next = first;
+            first = record;
+        }
+    }
+
+    while (first)
+    {
+        SymbolReference* next = first->next;
+        delete first;
+        first = next;
+    }
+
+    double heapTime = milliseconds(start);
+    size_t heapAllocations = allocations;
+
+    allocations = 0;
+    start = chrono::steady_clock::now();
+
+    Arena* arena = new Arena();
+    Pool<SymbolReference>* references = new Pool<SymbolReference>(arena);
+
+    for (size_t i = 0; i < RECORDS; i++)
+    {
+        SymbolReference* record = references->create(i, 1, i, RelocationType::R_386_16, i + 2, false);
+
+        if (i % 2)
+            references->destroy(record);
+        else
+        {
+            record->next = first;
+            first = record;
+        }
+    }
+
+    delete references;
+    delete arena;
+
+    double arenaTime = milliseconds(start);
+    size_t arenaAllocations = allocations;
+
+    cout << RECORDS << " references, new/delete: " << heapTime << " ms, " << heapAllocations << " allocations; " <<
+        "arena: " << arenaTime << " ms, " << arenaAllocations << " allocations" << endl;
+
+    return 0;
+}
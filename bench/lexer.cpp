@@ -0,0 +1,140 @@
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+
+#include "../src/structures.h"
+#include "../src/token.h"
+
+using namespace std;
+
+/*
+    Throughput of the lexer against the regex cascade it replaced. Both
+    classify the same operands over and over; the cascade is kept here only as
+    a reference, with the alias rewriting and the thirteen patterns tried in
+    order, as Token::parse did before (arithmetic expressions left out, the
+    sample has none). Every operand is checked to get the same type from both.
+*/
+
+#define LEXER_ROUNDS 2000
+#define CASCADE_ROUNDS 20
+
+static const char* operands[] = {
+    "start:", ".section", ".global", ".word", ".skip", ".end",
+    "mov", "movb", "add", "jmp", "jeq", "halt", "push", "shr",
+    "%r1", "%r7", "%sp", "%pc", "%psw", "%r1l", "%r2h",
+    "$5", "$0x1F", "$counter", "*%r3", "*table", "*0x10",
+    "value", "0xFF00", "-12", "counter(%pc)", "table(%r3)", "4(%r5)", "(%r4)", "*2(%r1)"
+};
+
+#define NUMBER_OF_OPERANDS (sizeof(operands) / sizeof(operands[0]))
+
+static const regex cascade[] = {
+    regex("^\\.(global|extern)$"),
+    regex("^([a-zA-Z][a-zA-Z0-9_]*):$"),
+    regex("^\\.section$"),
+    regex("^\\.(byte|equ|skip|word)$"),
+    regex("^(halt|ret|iret|int|jmp|jeq|jne|jgt|call|(not|push|pop|xchg|mov|add|sub|mul|div|cmp|and|or|xor|test|shl|shr)(b|w){0,1})$"),
+    regex("^.end$"),
+    regex("^(\\+|\\-){1}$"),
+    regex("^[a-zA-Z][a-zA-Z0-9_]*$"),
+    regex("^(\\-|\\+){0,1}[0-9]+$"),
+    regex("^0x[0-9a-fA-F]{1,}$"),
+    regex("^%r([0-7]|15)(h|l){0,1}$"),
+    regex("^[a-zA-Z][a-zA-Z0-9_]*\\(%r7\\)$"),
+    regex("^([a-zA-Z][a-zA-Z0-9_]*|(\\-|\\+){0,1}[0-9]+|0x[0-9a-fA-F]{1,}|)\\(%r([0-7]|15)(h|l){0,1}\\)$")
+};
+
+static TokenType classifyWithCascade(string data)
+{
+    data = regex_replace(data, regex("%sp"), "%r6");
+    data = regex_replace(data, regex("%pc"), "%r7");
+    data = regex_replace(data, regex("%psw"), "%r15");
+
+    int prefix = 0;
+
+    if (data[0] == '*' || data[0] == '$')
+    {
+        prefix = data[0] == '*' ? 1 : 2;
+        data = data.substr(1);
+    }
+
+    static const TokenType plain[] = {
+        TokenType::ACCESS_MODIFIER, TokenType::LABEL, TokenType::SECTION, TokenType::DIRECTIVE,
+        TokenType::INSTRUCTION, TokenType::END_OF_SECTIONS, TokenType::ARITHMETIC_OPERATOR
+    };
+
+    for (int i = 0; i < (int)(sizeof(cascade) / sizeof(cascade[0])); i++)
+    {
+        if (!regex_match(data, cascade[i]))
+            continue;
+
+        switch (i)
+        {
+            case 7:
+                return prefix == 1 ? TokenType::ASTERISK_SYMBOL : prefix == 2 ? TokenType::IMMEDIATE_SYMBOL : TokenType::SYMBOL;
+            case 8:
+                return prefix == 1 ? TokenType::ASTERISK_DECIMAL : prefix == 2 ? TokenType::IMMEDIATE_DECIMAL : TokenType::DECIMAL;
+            case 9:
+                return prefix == 1 ? TokenType::ASTERISK_HEXADECIMAL : prefix == 2 ? TokenType::IMMEDIATE_HEXADECIMAL : TokenType::HEXADECIMAL;
+            case 10:
+                return TokenType::REGISTER_DIRECT;
+            case 11:
+                return TokenType::PC_RELATIVE;
+            case 12:
+                return TokenType::REGISTER_INDIRECT;
+            default:
+                return plain[i];
+        }
+    }
+
+    return TokenType::INVALID;
+}
+
+static double seconds(chrono::steady_clock::time_point since)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+int main()
+{
+    StringPool strings;
+    Token token;
+
+    for (size_t i = 0; i < NUMBER_OF_OPERANDS; i++)
+    {
+        token.lex(operands[i], 0, true, &strings);
+
+        if (token.getType() != classifyWithCascade(operands[i]))
+        {
+            cout << "Lexer and regex cascade disagree on '" << operands[i] << "'" << endl;
+            return 1;
+        }
+    }
+
+    size_t checksum = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (int round = 0; round < LEXER_ROUNDS; round++)
+        for (size_t i = 0; i < NUMBER_OF_OPERANDS; i++)
+        {
+            token.lex(operands[i], 0, true, &strings);
+            checksum += token.getType();
+        }
+
+    double lexer = LEXER_ROUNDS * NUMBER_OF_OPERANDS / seconds(start);
+
+    start = chrono::steady_clock::now();
+
+    for (int round = 0; round < CASCADE_ROUNDS; round++)
+        for (size_t i = 0; i < NUMBER_OF_OPERANDS; i++)
+            checksum += classifyWithCascade(operands[i]);
+
+    double regexCascade = CASCADE_ROUNDS * NUMBER_OF_OPERANDS / seconds(start);
+
+    cout << "lexer: " << (size_t)lexer << " operands/s, regex cascade: " << (size_t)regexCascade <<
+        " operands/s (" << (size_t)(lexer / regexCascade) << "x), checksum " << checksum << endl;
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+#include <string>
+
+#include "../src/assembler.h"
+#include "../src/exceptions.h"
+#include "../src/objectfile.h"
+
+using namespace std;
+
+/*
+    Time objdump needs for a large object: a generated source with many
+    global symbols and relocations is assembled into ELF and into the text
+    dump, both are loaded, and every symbol and every relocation is then
+    looked up once by name and by (section, offset).
+*/
+
+#define SYMBOLS 100000
+
+static double milliseconds(chrono::steady_clock::time_point since)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+static void measure(const string& path, const char* format)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ObjectFile object;
+    object.load(path);
+
+    double loadTime = milliseconds(start);
+
+    vector<string> names(SYMBOLS);
+    for (size_t i = 0; i < SYMBOLS; i++)
+        names[i] = "s" + to_string(i);
+
+    start = chrono::steady_clock::now();
+
+    size_t found = 0;
+    IdSection text = object.findSection("text")->entryNo;
+
+    for (size_t i = 0; i < SYMBOLS; i++)
+    {
+        found += object.findSymbol(names[i]) != nullptr;
+        found += object.findRelocation(text, 2 * i) != nullptr;
+    }
+
+    double lookupTime = milliseconds(start);
+
+    cout << format << ": load " << loadTime << " ms, " << 2 * SYMBOLS << " lookups " << lookupTime << " ms (" << found << " found)" << endl;
+}
+
+int main()
+{
+    try
+    {
+        {
+            ofstream input("objectbench.s");
+
+            input << ".section text:\n";
+
+            for (size_t i = 0; i < SYMBOLS; i++)
+                input << ".global s" << i << "\ns" << i << ": .word s" << (SYMBOLS - 1 - i) << "\n";
+
+            input << ".end\n";
+        }
+
+        AssemblerOptions options;
+
+        options.format = FORMAT_ELF;
+        Assembler* assembler = new Assembler("objectbench.s", "objectbench.o", options);
+        assembler->generate();
+        delete assembler;
+
+        options.format = FORMAT_TEXT;
+        assembler = new Assembler("objectbench.s", "objectbench.txt", options);
+        assembler->generate();
+        delete assembler;
+
+        measure("objectbench.o", "elf");
+        measure("objectbench.txt", "text");
+
+        remove("objectbench.s");
+        remove("objectbench.o");
+        remove("objectbench.txt");
+
+        return 0;
+    }
+    catch (AssemblyException& ex)
+    {
+        cout << ex.what() << endl;
+    }
+
+    return 1;
+}
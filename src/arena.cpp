@@ -0,0 +1,30 @@
+#include "arena.h"
+
+#include <stdint.h>
+
+Arena::~Arena()
+{
+    for (char* block : blocks)
+        delete[] block;
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    uintptr_t aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+    if (cursor == nullptr || aligned + size > (uintptr_t)end)
+    {
+        // records bigger than a block get a block of their own
+        size_t blockSize = size + alignment > ARENA_BLOCK_SIZE ? size + alignment : ARENA_BLOCK_SIZE;
+
+        char* block = new char[blockSize];
+        blocks.push_back(block);
+
+        cursor = block;
+        end = block + blockSize;
+        aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+
+    cursor = (char*)(aligned + size);
+    return (void*)aligned;
+}
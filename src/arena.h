@@ -0,0 +1,100 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/*
+    Records which live as long as the assembler (pending references, .global
+    and .extern lists) are carved out of large blocks and never freed one by
+    one; all blocks are released together when the arena is destroyed. Only
+    trivially destructible records may be placed in the arena, since their
+    destructors are never called.
+*/
+
+class Arena
+{
+public:
+
+    Arena() {}
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        static_assert(is_trivially_destructible<T>::value, "Arena never calls destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    }
+
+private:
+
+    vector<char*> blocks;
+    char* cursor = nullptr;
+    char* end = nullptr;
+
+};
+
+/*
+    Records of one type which are dropped before the assembler is done (fixups
+    patched at label definition) go back to a free list and are handed out
+    again, so their memory is reused instead of growing the arena.
+*/
+
+template <typename T>
+class Pool
+{
+public:
+
+    Pool(Arena* arena) : arena(arena) {}
+
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        static_assert(is_trivially_destructible<T>::value, "Arena never calls destructors");
+
+        void* memory;
+
+        if (freeList == nullptr)
+            memory = arena->allocate(sizeof(Slot), alignof(Slot));
+        else
+        {
+            memory = freeList;
+            freeList = freeList->next;
+        }
+
+        return new (memory) T(forward<Args>(args)...);
+    }
+
+    void destroy(T* record)
+    {
+        Slot* slot = new (record) Slot;
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+private:
+
+    union Slot
+    {
+        Slot* next;
+        alignas(T) char storage[sizeof(T)];
+    };
+
+    Arena* arena;
+    Slot* freeList = nullptr;
+
+};
+
+#endif
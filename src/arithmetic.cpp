@@ -8,33 +8,6 @@ bool Arithmetic::isOperator(char c)
     return c == '+' || c == '-';
 }
 
-vector<Token> Arithmetic::convertToPostfix(vector<Token> input)
-{
-
-    vector<Token> result;
-    stack<Token> stack;
-
-    int rank = 0;
-
-    for (Token next : input)
-        if (next.getType() != TokenType::ARITHMETIC_OPERATOR) {
-            result.push_back(next);
-            rank++;
-            if (!stack.empty()) {
-                result.push_back(stack.top());
-                stack.pop();
-                rank--;
-            }
-        } else
-            stack.push(next);
-
-    if (rank != 1)
-        throw AssemblyException("Can't process arithmetic expression");
-
-    return result;
-
-}
-
 Token Arithmetic::returnToken(string data)
 {
     Token t = Token::parse(data, 0, true);
@@ -85,77 +58,83 @@ vector<Token> Arithmetic::tokenize(string expression)
 
 }
 
-unsigned long Arithmetic::calculateSymbolValue(vector<Token> tokens, SymbolTable* symbolTable, unsigned long section)
+Expression Arithmetic::compile(string expression, StringPool* strings)
+{
+    Expression result;
+    vector<Token> tokens = tokenize(expression);
+
+    // operands and operators have to alternate, starting and ending with operand
+    if (tokens.size() % 2 == 0)
+        throw AssemblyException("Can't process arithmetic expression");
+
+    result.reserve(tokens.size() / 2 + 1);
+
+    for (size_t i = 0; i < tokens.size(); i += 2)
+    {
+        Token& t = tokens[i];
+
+        if (i > 0 && tokens[i - 1].getType() != TokenType::ARITHMETIC_OPERATOR)
+            throw AssemblyException("Can't process arithmetic expression");
+
+        bool negative = i > 0 && tokens[i - 1].getValue() == "-";
+
+        switch (t.getType())
+        {
+            case TokenType::SYMBOL:
+            case TokenType::IMMEDIATE_SYMBOL:
+                result.push_back(ExpressionTerm(TERM_SYMBOL, negative, strings->intern(t.getValue())));
+            break;
+
+            case TokenType::DECIMAL:
+            case TokenType::HEXADECIMAL:
+            case TokenType::IMMEDIATE_DECIMAL:
+            case TokenType::IMMEDIATE_HEXADECIMAL:
+                result.push_back(ExpressionTerm(TERM_CONSTANT, negative, strtoul(t.getValue().c_str(), NULL, 0)));
+            break;
+
+            default:
+                throw AssemblyException("Can't process arithmetic expression");
+        }
+    }
+
+    return result;
+}
+
+bool Arithmetic::isConstant(const Expression& expression)
+{
+    for (const ExpressionTerm& term : expression)
+        if (term.type == TERM_SYMBOL)
+            return false;
+
+    return true;
+}
+
+unsigned long Arithmetic::calculateSymbolValue(const Expression& expression, SymbolTable* symbolTable)
 {
-    char buffer[256];
-    stack<Token> tmp;
     unsigned long rez = 0;
 
-    for (Token& t : tokens)
+    for (const ExpressionTerm& term : expression)
     {
-        
-        if (t.getType() == TokenType::ARITHMETIC_OPERATOR)
+        unsigned long v = term.value;
+
+        if (term.type == TERM_SYMBOL)
         {
-            Token op2 = tmp.top();
-            tmp.pop();
-            Token op1 = tmp.top();
-            tmp.pop();
-
-            const SymbolEntry* s2 = symbolTable->getEntryByName(op2.getValue());
-            const SymbolEntry* s1 = symbolTable->getEntryByName(op1.getValue());
-
-            if (
-                (op1.getType() == TokenType::IMMEDIATE_SYMBOL && s1 == nullptr) ||
-                (op2.getType() == TokenType::IMMEDIATE_SYMBOL && s2 == nullptr) ||
-                (op1.getType() == TokenType::SYMBOL && s1 == nullptr) ||
-                (op2.getType() == TokenType::SYMBOL && s2 == nullptr)
-            )
+            IdSymbol id = symbolTable->getIdByName(term.value);
+
+            if (id == ASM_UNDEFINED)
                 throw AssemblyException("Symbol is not found in symbol table when calculating symbol value");
 
-            if (
-                (s1 != nullptr && (s1->scope == Scope::LOCAL || s1->scope == Scope::GLOBAL) && !s1->defined) ||
-                (s2 != nullptr && (s2->scope == Scope::LOCAL || s2->scope == Scope::GLOBAL) && !s2->defined) 
-            )
-                throw exception();
-
-            unsigned long v2;
-            if (s2)
-                v2 = s2->value;
-            else
-                v2 = strtoul(op2.getValue().c_str(), NULL, 0);
-
-            unsigned long v1;
-            if (s1)
-                v1 = s1->value;
-            else
-                v1 = strtoul(op1.getValue().c_str(), NULL, 0);
-
-            if (t.getValue() == "-")
-                rez = v1 - v2;
-            else
-                rez = v1 + v2;
-
-            sprintf(buffer, "%lu", rez);
-
-            tmp.push(Token(TokenType::IMMEDIATE_DECIMAL, string(buffer)));
-
-        } else if (
-            t.getType() == TokenType::IMMEDIATE_SYMBOL || 
-            t.getType() == TokenType::IMMEDIATE_DECIMAL ||
-            t.getType() == TokenType::IMMEDIATE_HEXADECIMAL ||
-            t.getType() == TokenType::SYMBOL || 
-            t.getType() == TokenType::DECIMAL ||
-            t.getType() == TokenType::HEXADECIMAL
-        )
-            tmp.push(t);
-    }
+            if (symbolTable->getScope(id) != Scope::EXTERN && !symbolTable->isDefined(id))
+                throw AssemblyException("Symbol is not defined when calculating symbol value");
 
-    rez = strtoul(tmp.top().getValue().c_str(), NULL, 0);
-    tmp.pop();
+            v = symbolTable->getValue(id);
+        }
 
-    if (tmp.empty())
-        return rez;
-    else
-        throw AssemblyException("Can't process given postfix expression.");
+        if (term.negative)
+            rez -= v;
+        else
+            rez += v;
+    }
 
-}
\ No newline at end of file
+    return rez;
+}
@@ -16,9 +16,11 @@ public:
     static bool isOperator(char c);
     static Token returnToken(string data);
 
-    static vector<Token> convertToPostfix(vector<Token> input);
     static vector<Token> tokenize(string expression);
-    static unsigned long calculateSymbolValue(vector<Token> tokens, SymbolTable* symbolTable, unsigned long section = -1);
+    static Expression compile(string expression, StringPool* strings);
+
+    static bool isConstant(const Expression& expression);
+    static unsigned long calculateSymbolValue(const Expression& expression, SymbolTable* symbolTable);
 
 };
 
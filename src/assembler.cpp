@@ -1,19 +1,26 @@
 #include "assembler.h"
 
-Assembler::Assembler(string inputFile, string outputFile)
+Assembler::Assembler(string inputFile, string outputFile, AssemblerOptions options) : options(options)
 {
 
-    this->inputFile.open(inputFile, ios::in);
-    this->outputFile.open(outputFile, ios::out | ios::trunc);
+    budget.limit = options.maxMemory;
 
-    symbolTable = new SymbolTable();
-    sectionTable = new SectionTable();
+    source.open(inputFile);
+    outputPath = outputFile;
+
+    arena = new Arena();
+    references = new Pool<SymbolReference>(arena);
+
+    strings = new StringPool();
+    symbolTable = new SymbolTable(strings);
+    sectionTable = new SectionTable(strings);
     relocationTable = new RelocationTable();
-    tns = new TNSTable();
+    tns = new TNSTable(strings);
 
-    IdSection idSection = sectionTable->insertSection("UND", 0, 0);
+    IdAtom undefined = strings->intern("UND");
+    IdSection idSection = sectionTable->insertSection(undefined, 0, 0);
     IdSymbol idSymbol = symbolTable->insertSymbol(
-        "UND",
+        undefined,
         idSection,
         0,
         Scope::EXTERN,
@@ -29,103 +36,30 @@ Assembler::~Assembler() {
     delete relocationTable;
     delete sectionTable;
     delete symbolTable;
+    delete strings;
 
     outputFile.close();
-    inputFile.close();
-
-    struct SymbolElement *prev = nullptr, *curr = nullptr;
-    
-    curr = externSymbolFirst;
-    while (curr) {
-        prev = curr;
-        curr = curr->next;
-        delete prev;
-    }
-
-    curr = globalSymbolFirst;
-    while (curr) {
-        prev = curr;
-        curr = curr->next;
-        delete prev;
-    }
-
-}
-
-void Assembler::loadLocally() {
-
-    string line;
-    unsigned long lineCntr = 0;
-    char* duplicate = nullptr;
-    char* token = nullptr;
-
-    while (std::getline(inputFile, line))
-    {
-        lineCntr++;
-
-        if (line.find(COMMENT_SYMBOL) != string::npos)
-            line = line.substr(0, line.find(COMMENT_SYMBOL));
-
-        transform(line.begin(), line.end(), line.begin(), ::tolower);
-
-        vector<string>* collector = new vector<string>();
-
-        duplicate = strdup(line.c_str());
-        token = strtok(duplicate, DELIMITER);
-
-        while (token != NULL)
-        {
-            collector->push_back(string(token));
-            token = strtok(NULL, DELIMITER);
-        }
-
-        delete duplicate;
-
-        assembly.push_back(*collector);
-        collector->clear();
-        delete collector;
-
-        if (collector->size() > 0 && (*collector)[0] == DIRECTIVE_END)
-            break;
 
-    }
-
-    if (
-        assembly.size() == 0 || 
-        (assembly.at(assembly.size()-1).size() > 0 && Token::parse(assembly.at(assembly.size()-1).at(0), lineCntr, true).getType() != TokenType::END_OF_SECTIONS)
-    )
-        assembly.push_back({ DIRECTIVE_END });
-
-}
-
-void Assembler::writeToMachineCode(IdSection idSection, uint8_t byte) {
-
-    if ((machineCode.find(idSection) == machineCode.end()))
-        machineCode.insert({idSection, vector<uint8_t>()});
-
-    machineCode[idSection].push_back(byte);
-
-}
-
-void Assembler::writeToMachineCode(IdSection idSection, Instruction instruction) {
-
-    if ((machineCode.find(idSection) == machineCode.end()))
-        machineCode.insert({idSection, vector<uint8_t>()});
-
-    for (int i = 0; i < instruction.instructionSize; i++)
-        machineCode[idSection].push_back(instruction.operationCode[i]);
+    // references and .global/.extern lists are released with the arena
+    delete references;
+    delete arena;
 
 }
 
 void Assembler::generate() {
 
-    loadLocally();
-
     oneAndOnlyPass();
 
     resolveSymbols();
 
+    optimize();
+
+    relax();
+
     resolveTNSSymbols();
 
+    placeSections();
+
     backpatching();
 
     writeToOutputFile();
@@ -135,55 +69,88 @@ void Assembler::generate() {
 void Assembler::oneAndOnlyPass() {
 
     IdSection currentSection = START_SECTION;
-    SymbolEntry* entry = nullptr;
+    SectionBuffer* currentBuffer = nullptr;
     IdSymbol idSymbol = 0;
     unsigned long toWrite = 0;
     unsigned long padding = 0;
     unsigned long cntrLine = 0;
     unsigned long LC = 0;
-    bool allLiterals = false;
     Token userDefinedSection;
     Token operand;
 
-    for (vector<string> line : assembly) {
+    // tokens are lexed into these, so their storage is reused from line to line
+    Token currentToken;
+    vector<Token> operands;
+    string labelName;
+
+    // source is scanned one line at a time, tokens are views into it
+    SourceScanner scanner(source.getData(), source.getSize());
+    vector<string_view> lineTokens;
+
+    // source whose last line has tokens but does not start with .end gets one more line with .end
+    bool endMissing = true;
+
+    for (;;) {
+
+        // with a budget, source already read does not stay in memory either
+        if (budget.limit != 0)
+            source.release(scanner.getPosition());
+
+        if (!scanner.nextLine(lineTokens))
+        {
+            if (!endMissing)
+                break;
+
+            lineTokens.assign(1, string_view(DIRECTIVE_END));
+        }
 
         cntrLine++;
-        if (line.size() == 0) continue;
 
-        queue<string> currentLineTokens;
-        for (string s : line) currentLineTokens.push(s);
+        // tokens of the line still to be read are [next, end)
+        size_t next = 0;
+        size_t end = lineTokens.size();
+
+        endMissing = false;
+
+        if (next == end) continue;
+
+        currentToken.lex(lineTokens[next++], cntrLine, true);
 
-        Token currentToken = Token::parse(currentLineTokens.front(), cntrLine, true);
-        currentLineTokens.pop();
+        endMissing = currentToken.getType() != TokenType::END_OF_SECTIONS;
         
-        string labelName;
+        labelName.clear();
         if (currentToken.getType() == TokenType::LABEL)
         {
             labelName = currentToken.getValue();
+            IdAtom label = strings->intern(labelName);
 
             if (currentSection == START_SECTION)
                 throw AssemblyException("Label '" + labelName + "' is defined outside of any section", cntrLine);
 
-            if (symbolTable->getEntryByName(labelName) != nullptr && symbolTable->getEntryByName(labelName)->defined)
+            idSymbol = symbolTable->getIdByName(label);
+
+            if (idSymbol != ASM_UNDEFINED && symbolTable->isDefined(idSymbol))
                 throw AssemblyException("Label '" + labelName + "' is already defined", cntrLine);
             
-            if (symbolTable->getEntryByName(labelName) != nullptr) {
-                symbolTable->getEntryByName(labelName)->defined = true;
-                symbolTable->getEntryByName(labelName)->value = LC;
-            } else 
+            if (idSymbol != ASM_UNDEFINED)
+                symbolTable->define(idSymbol, LC);
+            else {
                 idSymbol = symbolTable->insertSymbol(
-                    labelName,
+                    label,
                     currentSection,
                     LC,
                     Scope::LOCAL,
                     true // defined = true;
                 );
+                applyLocalFixups(label, currentSection, LC);
+            }
 
-            if (currentLineTokens.empty())
+            symbolTable->markLabel(idSymbol);
+
+            if (next == end)
                 continue;
             
-            currentToken = Token::parse(currentLineTokens.front(), cntrLine, true);
-            currentLineTokens.pop();
+            currentToken.lex(lineTokens[next++], cntrLine, true);
 
         }
 
@@ -201,30 +168,34 @@ void Assembler::oneAndOnlyPass() {
                 {
                     do
                     {
-                        operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                        currentLineTokens.pop();
+                        if (next == end)
+                            throw AssemblyException("Incorrect syntax", cntrLine);
+
+                        operand.lex(lineTokens[next++], cntrLine, true);
 
                         if (operand.getType() != TokenType::SYMBOL)
                             throw AssemblyException("Directive '.extern' should be followed by symbol or list of symbols", cntrLine);
 
-                        appendExternSymbolElem(operand.getValue());
+                        appendExternSymbolElem(strings->intern(operand.getValue()));
 
-                    } while (!currentLineTokens.empty());
+                    } while (next != end);
                 } 
 
                 else if (currentToken.getValue() == MODIFIER_GLOBAL)
                 {
                     do
                     {
-                        operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                        currentLineTokens.pop();
+                        if (next == end)
+                            throw AssemblyException("Incorrect syntax", cntrLine);
+
+                        operand.lex(lineTokens[next++], cntrLine, true);
 
                         if (operand.getType() != TokenType::SYMBOL)
                             throw AssemblyException("Directive '.global' should be followed by symbol or list of symbols", cntrLine);
 
-                        appendGlobalSymbolElem(operand.getValue());
+                        appendGlobalSymbolElem(strings->intern(operand.getValue()));
 
-                    } while (!currentLineTokens.empty());
+                    } while (next != end);
                 }
             }
             break;
@@ -239,8 +210,10 @@ void Assembler::oneAndOnlyPass() {
 
                     do {
 
-                        operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                        currentLineTokens.pop();
+                        if (next == end)
+                            throw AssemblyException("Incorrect syntax", cntrLine);
+
+                        operand.lex(lineTokens[next++], cntrLine, true);
 
                         if ((operand.getType() != TokenType::DECIMAL) &&
                             (operand.getType() != TokenType::HEXADECIMAL) && 
@@ -254,21 +227,23 @@ void Assembler::oneAndOnlyPass() {
                         else // operand.getType() == TokenType::SYMBOL
                         {
                             toWrite = 0;
-                            referencingSymbol(operand.getValue(), currentSection, LC, RelocationType::R_386_16, 0, true);
+                            referencingSymbol(strings->intern(operand.getValue()), currentSection, LC, RelocationType::R_386_16, 0, true);
                         }
 
-                        writeToMachineCode(currentSection, (uint8_t)toWrite);
+                        currentBuffer->append((uint8_t)toWrite);
 
                         LC++;
 
-                    } while (!currentLineTokens.empty());
+                    } while (next != end);
 
                 }
 
                 else if (currentToken.getValue() == DIRECTIVE_SKIP)
                 {
-                    operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                    currentLineTokens.pop();
+                    if (next == end)
+                        throw AssemblyException("Incorrect syntax", cntrLine);
+
+                    operand.lex(lineTokens[next++], cntrLine, true);
 
                     if (operand.getType() != TokenType::DECIMAL &&
                         operand.getType() != TokenType::HEXADECIMAL)
@@ -279,8 +254,7 @@ void Assembler::oneAndOnlyPass() {
                     else if (operand.getType() == TokenType::HEXADECIMAL)
                         padding = stoul(operand.getValue(), nullptr, 16);
 
-                    for (int i = 0; i < padding; i++)
-                        writeToMachineCode(currentSection, 0);
+                    currentBuffer->appendZeros(padding);
                     
                     LC += padding;
                 }
@@ -290,8 +264,10 @@ void Assembler::oneAndOnlyPass() {
 
                     do
                     {
-                        operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                        currentLineTokens.pop();
+                        if (next == end)
+                            throw AssemblyException("Incorrect syntax", cntrLine);
+
+                        operand.lex(lineTokens[next++], cntrLine, true);
 
                         if ((operand.getType() != TokenType::DECIMAL) &&
                             (operand.getType() != TokenType::HEXADECIMAL) && 
@@ -305,59 +281,43 @@ void Assembler::oneAndOnlyPass() {
                         else // operand.getType() == SYMBOL
                         {
                             toWrite = 0;
-                            referencingSymbol(operand.getValue(), currentSection, LC, RelocationType::R_386_16, 0, false);
+                            referencingSymbol(strings->intern(operand.getValue()), currentSection, LC, RelocationType::R_386_16, 0, false);
                         }
 
-                        writeToMachineCode(currentSection, (uint8_t)(toWrite & 0xFF));
-                        writeToMachineCode(currentSection, (uint8_t)((toWrite >> 8) & 0xFF));
+                        uint8_t word[2] = { (uint8_t)(toWrite & 0xFF), (uint8_t)((toWrite >> 8) & 0xFF) };
+                        currentBuffer->append(word, 2);
 
                         LC += 2;
 
-                    } while (!currentLineTokens.empty());
+                    } while (next != end);
 
                 }
                 
                 else if (currentToken.getValue() == DIRECTIVE_EQU)
                 {
 
-                    operand = Token::parse(currentLineTokens.front(), cntrLine, false);
-                    currentLineTokens.pop();
+                    if (next == end)
+                        throw AssemblyException("Incorrect syntax", cntrLine);
+
+                    operand.lex(lineTokens[next++], cntrLine, false);
 
                     if (operand.getType() != TokenType::SYMBOL)
                         throw AssemblyException("Directive '.equ' requires label as first operand.", cntrLine);
 
                     string expression;
-                    while (currentLineTokens.size())
-                    {
-                        expression += currentLineTokens.front();
-                        currentLineTokens.pop();
-                    }
+                    while (next != end)
+                        expression += lineTokens[next++];
 
-                    allLiterals = true;
-                    
-                    vector<Token> arithmeticTokens = Arithmetic::tokenize(expression);
-                    
-                    for (const Token& t : arithmeticTokens)
-                        if (
-                            t.getType() != TokenType::ARITHMETIC_OPERATOR &&
-                            t.getType() != TokenType::DECIMAL && 
-                            t.getType() != TokenType::IMMEDIATE_DECIMAL &&
-                            t.getType() != TokenType::HEXADECIMAL && 
-                            t.getType() != TokenType::IMMEDIATE_HEXADECIMAL 
-                        )
-                        {
-                            allLiterals = false;
-                            break;
-                        }
+                    Expression compiled = Arithmetic::compile(expression, strings);
 
-                    if (allLiterals) { // can be calculated right now
+                    IdAtom symbol = strings->intern(operand.getValue());
 
-                        arithmeticTokens = Arithmetic::convertToPostfix(arithmeticTokens);
+                    if (Arithmetic::isConstant(compiled)) { // can be calculated right now
 
                         symbolTable->insertSymbol(
-                            operand.getValue(),
+                            symbol,
                             currentSection,
-                            Arithmetic::calculateSymbolValue(arithmeticTokens, symbolTable, currentSection),
+                            Arithmetic::calculateSymbolValue(compiled, symbolTable),
                             Scope::LOCAL,
                             true
                         );
@@ -365,14 +325,14 @@ void Assembler::oneAndOnlyPass() {
                     } else { // add to tns
 
                         symbolTable->insertSymbol(
-                            operand.getValue(),
+                            symbol,
                             currentSection,
                             ASM_UNDEFINED,
                             Scope::LOCAL,
                             false
                         );
 
-                        tns->insertSymbol(currentSection, operand.getValue(), expression, Scope::LOCAL);
+                        tns->insertSymbol(currentSection, symbol, move(compiled), Scope::LOCAL);
 
                     }
 
@@ -385,29 +345,44 @@ void Assembler::oneAndOnlyPass() {
                 if (currentSection != START_SECTION) 
                     sectionTable->getEntryByID(currentSection)->length = LC;
             
-                if (currentLineTokens.size() == 0)
+                if (next == end)
                     throw AssemblyException("Directive '.section' should be followed by the name of new section", cntrLine);
 
-                userDefinedSection = Token::parse(currentLineTokens.front(), cntrLine, true);
-                currentLineTokens.pop();
+                userDefinedSection.lex(lineTokens[next++], cntrLine, true);
 
                 if (userDefinedSection.getType() != TokenType::LABEL)
                     throw new AssemblyException("Directive '.section' should be followed by the name of new section", cntrLine);
 
-                if (!currentLineTokens.empty())
+                if (next != end)
                     throw AssemblyException("Incorrect syntax", cntrLine);
 
-                currentSection = sectionTable->insertSection(userDefinedSection.getValue(), 0, cntrLine);
+                IdAtom sectionName = strings->intern(userDefinedSection.getValue());
+
+                currentSection = sectionTable->insertSection(sectionName, 0, cntrLine);
                 idSymbol = symbolTable->insertSymbol(
-                    userDefinedSection.getValue(),
+                    sectionName,
                     currentSection,
                     0,
                     Scope::LOCAL,
                     true
                 );
                 sectionTable->getEntryByID(currentSection)->SymbolEntryNo = idSymbol;
+                symbolTable->markLabel(idSymbol);
                 LC = 0;
 
+                // section IDs are handed out in order, buffer of the new section is the last one
+                machineCode.resize(currentSection + 1);
+                currentBuffer = &machineCode[currentSection];
+                currentBuffer->setBudget(&budget);
+
+                // code is denser than its source, so at most half of what is left of the input;
+                // budget is charged for capacity, so with a budget buffers grow only as written
+                if (budget.limit == 0)
+                {
+                    size_t remaining = source.getSize() - (lineTokens[0].data() - source.getData());
+                    currentBuffer->reserve(min(remaining / 2, (size_t)SECTION_RESERVE_LIMIT));
+                }
+
             }
             break;
 
@@ -421,27 +396,40 @@ void Assembler::oneAndOnlyPass() {
             case TokenType::INSTRUCTION:
             {
 
-                queue<Token> _instruction;
-                _instruction.push(currentToken);
+                if (currentSection == START_SECTION)
+                    throw AssemblyException("Instruction '" + currentToken.getValue() + "' is defined outside of any section", cntrLine);
 
-                while (!currentLineTokens.empty())
-                {
-                    operand = Token::parse(currentLineTokens.front(), cntrLine, true);
-                    _instruction.push(operand);
-                    currentLineTokens.pop();
-                }
+                // grows only, so tokens keep their storage for the next instruction
+                size_t numberOfOperands = end - next;
+                if (operands.size() < numberOfOperands)
+                    operands.resize(numberOfOperands);
 
-                Instruction instruction(
-                    _instruction, 
+                for (size_t i = 0; i < numberOfOperands; i++)
+                    operands[i].lex(lineTokens[next++], cntrLine, true, strings);
+
+                // encoded straight into the section
+                size_t size = Instruction::encode(
+                    currentToken,
+                    operands.data(),
+                    numberOfOperands,
                     cntrLine,
                     LC, // before instruction
                     currentSection,
-                    this
+                    this,
+                    currentBuffer->claim(INSTRUCTION_MAXIMUM_SIZE)
                 );
 
-                LC += instruction.instructionSize;
+                if (options.optimizationLevel > 0)
+                {
+                    if (instructions.size() <= currentSection)
+                        instructions.resize(currentSection + 1);
+
+                    instructions[currentSection].push_back({LC, (uint8_t)size});
+                }
 
-                writeToMachineCode(currentSection, instruction);
+                LC += size;
+
+                currentBuffer->advance(size);
 
             break;
             }
@@ -454,50 +442,107 @@ void Assembler::oneAndOnlyPass() {
 
 void Assembler::writeToOutputFile() {
 
+    if (options.format == FORMAT_BINARY) {
+        BinaryWriter(strings, sectionTable, relocationTable, machineCode).writeImage(outputPath);
+        return;
+    }
+
+    if (options.format == FORMAT_BINARY_SECTIONS) {
+        BinaryWriter(strings, sectionTable, relocationTable, machineCode).writeSections(outputPath);
+        return;
+    }
+
+    outputFile.open(outputPath, ios::out | ios::trunc | ios::binary);
+
+    if (!outputFile)
+        throw AssemblyException("Unable to open output file '" + outputPath + "'.");
+
+    if (options.format == FORMAT_TEXT)
+        writeTextDump();
+    else
+        ElfWriter(strings, symbolTable, sectionTable, relocationTable, machineCode).write(outputFile);
+
+}
+
+void Assembler::writeTextDump() {
+
+    TextWriter writer(outputFile);
+
     /* write relevant tables */
 
-    outputFile << "<--Symbol table-->" << endl;
-    outputFile << symbolTable->generateTextualSymbolTable().str() << endl << endl;
+    writer.text("<--Symbol table-->\n");
+    symbolTable->generateTextualSymbolTable(writer);
+    writer.text("\n\n");
 
-    outputFile << "<--Section table-->" << endl;
-    outputFile << sectionTable->generateTextualSectionTable().str() << endl << endl;
+    writer.text("<--Section table-->\n");
+    sectionTable->generateTextualSectionTable(writer, !options.sectionAddresses.empty());
+    writer.text("\n\n");
 
     /* write machine code */
 
-    int currentBytesInline;
-    map<IdSection, vector<uint8_t>>::iterator it;
+    for (IdSection idSection = 0; idSection < machineCode.size(); idSection++) {
 
-    for (it = machineCode.begin(); it != machineCode.end(); it++) {
+        // sections nothing was written into are left out
+        if (machineCode[idSection].isEmpty())
+            continue;
 
-        outputFile << "<--Section '" <<  sectionTable->getEntryByID(it->first)->name << "'-->" << endl << endl;
-        outputFile << relocationTable->generateTextualRelocationTable(it->first).str() << endl;
+        const SectionBuffer& buffer = machineCode[idSection];
 
-        currentBytesInline = 0;
+        writer.text("<--Section '");
+        writer.text(strings->getString(sectionTable->getEntryByID(idSection)->name));
+        writer.text("'-->\n\n");
+        relocationTable->generateTextualRelocationTable(writer, idSection);
+        writer.character('\n');
 
-        for (int i = 0; i < it->second.size(); i++) {
+        // every BYTES_INLINE-th byte ends the line
+        size_t offset = 0, skipped = 0;
+
+        auto separator = [](size_t offset) {
+            return (offset + 1) % BYTES_INLINE == 0 ? '\n' : ' ';
+        };
+
+        // stored bytes from offset up to end
+        auto extent = [&](size_t end) {
+            buffer.read(offset - skipped, end - skipped, [&](const uint8_t* bytes, size_t count) {
+                for (size_t i = 0; i < count; i++, offset++)
+                    writer.byte(bytes[i], separator(offset));
+            });
+        };
+
+        for (const ZeroRun& run: buffer.getZeroRuns()) {
+
+            extent(run.offset);
+
+            size_t end = run.offset + run.length;
+
+            // whole lines of zeros are written as one line with their count
+            while (offset < end)
+                if (offset % BYTES_INLINE == 0 && end - offset >= TEXT_ZERO_RUN_MINIMUM) {
+                    size_t zeros = (end - offset) / BYTES_INLINE * BYTES_INLINE;
+                    writer.text("* 0x");
+                    writer.hex(zeros);
+                    writer.text(" zero bytes\n");
+                    offset += zeros;
+                } else {
+                    writer.byte(0, separator(offset));
+                    offset++;
+                }
+
+            skipped += run.length;
 
-            outputFile << hex << ((it->second[i]  >> 4) & 0xF);
-            outputFile << hex << (it->second[i]  & 0xF);
-        
-            if (++currentBytesInline == BYTES_INLINE)
-            {
-                currentBytesInline = 0;
-                outputFile << endl;
-            }
-            else
-                outputFile << " ";
         }
 
-        outputFile << endl << endl << endl;
+        extent(buffer.getSize());
 
-    }
+        writer.text("\n\n\n");
 
+    }
 
 }
 
-void Assembler::appendGlobalSymbolElem(string symbol) {
+void Assembler::appendGlobalSymbolElem(IdAtom symbol) {
 
-    struct SymbolElement* temp = new SymbolElement(symbol, nullptr);
+    struct SymbolElement* temp = arena->create<SymbolElement>(symbol, nullptr);
 
     if (globalSymbolFirst == nullptr)
         globalSymbolLast = globalSymbolFirst = temp;
@@ -506,9 +551,9 @@ void Assembler::appendGlobalSymbolElem(string symbol) {
 
 }
 
-void Assembler::appendExternSymbolElem(string symbol) {
+void Assembler::appendExternSymbolElem(IdAtom symbol) {
 
-    struct SymbolElement* temp = new SymbolElement(symbol, nullptr);
+    struct SymbolElement* temp = arena->create<SymbolElement>(symbol, nullptr);
 
     if (externSymbolFirst == nullptr)
         externSymbolLast = externSymbolFirst = temp;
@@ -520,18 +565,18 @@ void Assembler::appendExternSymbolElem(string symbol) {
 void Assembler::resolveSymbols() {
 
     struct SymbolElement *curr = nullptr;
-    SymbolEntry *symbol = nullptr;
+    IdSymbol symbol = 0;
 
     // resolve global symbols
     curr = globalSymbolFirst;
     while (curr) {
 
-        symbol = symbolTable->getEntryByName(curr->symbol);
+        symbol = symbolTable->getIdByName(curr->symbol);
 
-        if (symbol == nullptr || !symbol->defined)
-            throw AssemblyException("Symbol '" + curr->symbol + "' is declared as global, but isn't defined");
+        if (symbol == ASM_UNDEFINED || !symbolTable->isDefined(symbol))
+            throw AssemblyException("Symbol '" + strings->getString(curr->symbol) + "' is declared as global, but isn't defined");
         
-        symbol->scope = Scope::GLOBAL;
+        symbolTable->setScope(symbol, Scope::GLOBAL);
         
         curr = curr->next;
     
@@ -541,10 +586,10 @@ void Assembler::resolveSymbols() {
     curr = externSymbolFirst;
     while (curr) {
 
-        if (symbolTable->getEntryByName(curr->symbol) != nullptr)
-            throw AssemblyException("Symbol '" + curr->symbol + "' is declared as extern, but is defined");
+        if (symbolTable->getIdByName(curr->symbol) != ASM_UNDEFINED)
+            throw AssemblyException("Symbol '" + strings->getString(curr->symbol) + "' is declared as extern, but is defined");
         
-        symbol = symbolTable->getEntryByID(symbolTable->insertSymbol(curr->symbol, 0, 0, Scope::EXTERN, false));
+        symbolTable->insertSymbol(curr->symbol, 0, 0, Scope::EXTERN, false);
 
         curr = curr->next;
 
@@ -552,35 +597,456 @@ void Assembler::resolveSymbols() {
 
 }
 
+void Assembler::placeSections() {
+
+    vector<SectionEntry*> placed;
+
+    for (const pair<const string, unsigned long>& placement: options.sectionAddresses) {
+
+        IdAtom name = strings->find(placement.first);
+        SectionEntry* entry = name == ASM_UNDEFINED ? nullptr : sectionTable->getEntryByName(name);
+
+        if (entry == nullptr || entry->entryNo == 0)
+            throw AssemblyException("Section '" + placement.first + "' is given an address, but is not defined");
+
+        if (placement.second + entry->length > ADDRESS_SPACE_SIZE)
+            throw AssemblyException("Section '" + placement.first + "' does not fit in address space at given address");
+
+        entry->address = placement.second;
+        placed.push_back(entry);
+
+    }
+
+    sort(placed.begin(), placed.end(), [](const SectionEntry* a, const SectionEntry* b) {
+        return a->address < b->address;
+    });
+
+    for (size_t i = 1; i < placed.size(); i++)
+        if (placed[i - 1]->address + placed[i - 1]->length > placed[i]->address)
+            throw AssemblyException(
+                "Sections '" + strings->getString(placed[i - 1]->name) + "' and '" + 
+                strings->getString(placed[i]->name) + "' overlap"
+            );
+
+}
+
+void Assembler::optimize() {
+
+    if (options.optimizationLevel == 0)
+        return;
+
+    vector<vector<ByteRange>> removals(machineCode.size());
+    vector<size_t> removedInstructions(machineCode.size(), 0), removedBytes(machineCode.size(), 0);
+    vector<vector<unsigned long>> labels(machineCode.size());
+    vector<SymbolReference*> pending;
+    size_t rounds = 0;
+    bool shrunk;
+
+    // removing an instruction may bring a jump right in front of its target,
+    // so this is repeated until nothing changes; code only shrinks, so it ends
+    do {
+
+        shrunk = false;
+        rounds++;
+
+        // a label may be jumped to from anywhere, instructions are never merged across it
+        for (vector<unsigned long>& section : labels)
+            section.clear();
+
+        for (IdSymbol id = 0; id < symbolTable->getIdBound(); id++)
+            if (symbolTable->exists(id) && symbolTable->isLabel(id) && symbolTable->getSection(id) < labels.size())
+                labels[symbolTable->getSection(id)].push_back(symbolTable->getValue(id));
+
+        for (vector<unsigned long>& section : labels)
+            sort(section.begin(), section.end());
+
+        pending.clear();
+
+        for (SymbolFixups& chain : fixups)
+            for (SymbolReference* curr = chain.first; curr; curr = curr->next)
+                if (!curr->removed)
+                    pending.push_back(curr);
+
+        sort(pending.begin(), pending.end(), [](const SymbolReference* a, const SymbolReference* b) {
+            return a->inSection != b->inSection ? a->inSection < b->inSection : a->patch < b->patch;
+        });
+
+        for (IdSection idSection = 0; idSection < instructions.size(); idSection++) {
+
+            vector<EncodedInstruction>& code = instructions[idSection];
+            size_t kept = 0, removed = 0;
+
+            for (size_t i = 0; i < code.size(); ) {
+
+                size_t count = matchPeephole(idSection, i, labels[idSection], pending);
+
+                if (count == 0) {
+                    // instructions left move down by whatever was removed before them
+                    code[kept++] = {code[i].offset - removed, code[i].size};
+                    i++;
+                    continue;
+                }
+
+                size_t length = 0;
+                for (size_t j = i; j < i + count; j++)
+                    length += code[j].size;
+
+                removals[idSection].push_back({code[i].offset, length});
+                removedInstructions[idSection] += count;
+                removedBytes[idSection] += length;
+                removed += length;
+
+                i += count;
+                shrunk = true;
+
+            }
+
+            code.resize(kept);
+
+        }
+
+        if (shrunk)
+            shrinkSections(removals);
+
+    } while (shrunk);
+
+    instructions.clear();
+
+    size_t totalInstructions = 0, totalBytes = 0;
+    for (IdSection idSection = 0; idSection < removedBytes.size(); idSection++) {
+        totalInstructions += removedInstructions[idSection];
+        totalBytes += removedBytes[idSection];
+    }
+
+    cout << "Peephole optimization removed " << totalInstructions << (totalInstructions == 1 ? " instruction" : " instructions") << 
+        " (" << totalBytes << " bytes) in " << rounds << (rounds == 1 ? " round" : " rounds") << endl;
+
+    for (IdSection idSection = 0; idSection < removedBytes.size(); idSection++)
+        if (removedInstructions[idSection] != 0)
+            cout << "    " << strings->getString(sectionTable->getEntryByID(idSection)->name) << ": " << 
+                removedInstructions[idSection] << (removedInstructions[idSection] == 1 ? " instruction, " : " instructions, ") << 
+                removedBytes[idSection] << " bytes" << endl;
+
+}
+
+size_t Assembler::matchPeephole(IdSection idSection, size_t index, const vector<unsigned long>& labels, const vector<SymbolReference*>& pending) {
+
+    const vector<EncodedInstruction>& code = instructions[idSection];
+    DecodedInstruction current = decodeInstruction(idSection, code[index]);
+    unsigned long end = code[index].offset + code[index].size;
+
+    // jump to the instruction right behind it, taken or not, execution goes on there
+    if (Mnemonics::isJump(current.operationCode) && current.mode[0] == formDetails[FORM_IMMEDIATE].mode) {
+
+        SymbolReference* reference = findReference(pending, idSection, current.payload[0]);
+        IdSymbol id = reference == nullptr ? ASM_UNDEFINED : findLabel(reference->symbol);
+
+        if (
+            id != ASM_UNDEFINED &&
+            reference->relocationType == RelocationType::R_386_16 &&
+            symbolTable->getSection(id) == idSection &&
+            symbolTable->getValue(id) == end
+        ) {
+            reference->removed = true;
+            return 1;
+        }
+
+        return 0;
+
+    }
+
+    // everything else needs the instruction executed right after it, data in between ends the sequence
+    if (index + 1 == code.size() || code[index + 1].offset != end)
+        return 0;
+
+    DecodedInstruction following = decodeInstruction(idSection, code[index + 1]);
+    uint8_t registerDirect = formDetails[FORM_REGISTER_DIRECT].mode;
+
+    // push %rX; pop %rX leaves both the register and sp as they were; for sp
+    // and pc it does not, and nobody may jump in between
+    if (
+        current.operationCode == 9 && following.operationCode == 10 &&
+        current.size == OperandSize::WORD && following.size == OperandSize::WORD &&
+        current.mode[0] == registerDirect && following.mode[0] == registerDirect &&
+        current.registerNumber[0] == following.registerNumber[0] &&
+        current.registerNumber[0] != 6 && current.registerNumber[0] != 7 &&
+        !binary_search(labels.begin(), labels.end(), code[index + 1].offset)
+    )
+        return 2;
+
+    bool isNoOperation = false;
+
+    // mov %rX, %rX
+    if (current.operationCode == 12)
+        isNoOperation =
+            current.mode[0] == registerDirect && current.mode[1] == registerDirect &&
+            current.registerNumber[0] == current.registerNumber[1] &&
+            current.half[0] == current.half[1];
+
+    // add $0, %rX and sub $0, %rX, literal zero only, a symbol may still turn out to be anything
+    if (current.operationCode == 13 || current.operationCode == 14)
+        isNoOperation =
+            current.mode[0] == formDetails[FORM_IMMEDIATE].mode && current.mode[1] == registerDirect &&
+            machineCode[idSection].getByte(current.payload[0]) == 0 &&
+            (current.size == OperandSize::BYTE || machineCode[idSection].getByte(current.payload[0] + 1) == 0) &&
+            findReference(pending, idSection, current.payload[0]) == nullptr;
+
+    if (!isNoOperation)
+        return 0;
+
+    // these still set flags, so they go only if the next instruction sets at
+    // least the same flags over them and does not read psw first
+    uint8_t flags = operationDetails[current.operationCode].flags;
+
+    if ((operationDetails[following.operationCode].flags & flags) != flags)
+        return 0;
+
+    for (size_t i = 0; i < following.numberOfOperands; i++)
+        if (following.mode[i] == registerDirect && following.registerNumber[i] == 15)
+            return 0;
+
+    return 1;
+
+}
+
+DecodedInstruction Assembler::decodeInstruction(IdSection idSection, const EncodedInstruction& instruction) {
+
+    const SectionBuffer& buffer = machineCode[idSection];
+    DecodedInstruction decoded = {};
+
+    uint8_t descriptor = buffer.getByte(instruction.offset);
+    decoded.operationCode = descriptor >> 3;
+    decoded.size = (OperandSize)((descriptor >> 2) & 1);
+
+    unsigned long offset = instruction.offset + 1, end = instruction.offset + instruction.size;
+
+    while (offset < end && decoded.numberOfOperands < 2) {
+
+        uint8_t i = decoded.numberOfOperands++;
+        descriptor = buffer.getByte(offset);
+
+        decoded.mode[i] = descriptor >> 5;
+        decoded.registerNumber[i] = (descriptor >> 1) & 0xF;
+        decoded.half[i] = descriptor & 1;
+        decoded.payload[i] = offset + 1;
+
+        // first five forms are listed in order of their mode bits
+        offset += 1 + formDetails[decoded.mode[i]].payload[decoded.size];
+
+    }
+
+    return decoded;
+
+}
+
+SymbolReference* Assembler::findReference(const vector<SymbolReference*>& pending, IdSection idSection, unsigned long patch) {
+
+    vector<SymbolReference*>::const_iterator it = lower_bound(pending.begin(), pending.end(), make_pair(idSection, patch), 
+        [](const SymbolReference* reference, const pair<IdSection, unsigned long>& key) {
+            return reference->inSection != key.first ? reference->inSection < key.first : reference->patch < key.second;
+        }
+    );
+
+    if (it == pending.end() || (*it)->inSection != idSection || (*it)->patch != patch || (*it)->removed)
+        return nullptr;
+
+    return *it;
+
+}
+
+void Assembler::relax() {
+
+    if (!options.relax)
+        return;
+
+    vector<vector<ByteRange>> removals(machineCode.size());
+    vector<size_t> saved(machineCode.size(), 0);
+    size_t rounds = 0;
+    bool shrunk;
+
+    // dropping a displacement moves labels after it, which may bring another
+    // PC relative displacement to zero; nothing ever grows, so this ends
+    do {
+
+        shrunk = false;
+        rounds++;
+
+        for (SymbolReference*& reference : relaxable) {
+
+            if (reference == nullptr || reference->removed || !isZeroDisplacement(reference))
+                continue;
+
+            SectionBuffer& buffer = machineCode[reference->inSection];
+
+            // register indirect with displacement becomes register indirect
+            buffer.patchByte(reference->patch - 1, (buffer.getByte(reference->patch - 1) & 0x1F) | (2 << 5));
+
+            removals[reference->inSection].push_back({reference->patch, 2});
+            saved[reference->inSection] += 2;
+
+            reference->removed = true;
+            reference = nullptr;
+            shrunk = true;
+
+        }
+
+        if (shrunk)
+            shrinkSections(removals);
+
+    } while (shrunk);
+
+    relaxable.clear();
+
+    size_t total = 0;
+    for (IdSection idSection = 0; idSection < saved.size(); idSection++)
+        total += saved[idSection];
+
+    cout << "Relaxation saved " << total << " bytes in " << rounds << (rounds == 1 ? " round" : " rounds") << endl;
+
+    for (IdSection idSection = 0; idSection < saved.size(); idSection++)
+        if (saved[idSection] != 0)
+            cout << "    " << strings->getString(sectionTable->getEntryByID(idSection)->name) << ": " << saved[idSection] << " bytes" << endl;
+
+}
+
+bool Assembler::isZeroDisplacement(const SymbolReference* reference) {
+
+    IdSymbol id = findLabel(reference->symbol);
+
+    if (id == ASM_UNDEFINED)
+        return false;
+
+    IdSection section = symbolTable->getSection(id);
+    unsigned long value = symbolTable->getValue(id);
+
+    if (reference->relocationType == RelocationType::R_386_PC16)
+        return section == reference->inSection && value == reference->nextInstructionLC;
+
+    // register indirect displacement is known only in a section with load address
+    map<string, unsigned long>::const_iterator it = options.sectionAddresses.find(strings->getString(sectionTable->getEntryByID(section)->name));
+
+    return it != options.sectionAddresses.end() && it->second + value == 0;
+
+}
+
+IdSymbol Assembler::findLabel(IdAtom symbol) {
+
+    IdSymbol id = symbolTable->getIdByName(symbol);
+
+    // only labels have values that are final here, TNS symbols are calculated later
+    if (
+        id == ASM_UNDEFINED ||
+        !symbolTable->isDefined(id) ||
+        !symbolTable->isLabel(id) ||
+        symbolTable->getScope(id) == Scope::EXTERN ||
+        tns->getIdByName(symbol) != ASM_UNDEFINED
+    )
+        return ASM_UNDEFINED;
+
+    return id;
+
+}
+
+void Assembler::shrinkSections(vector<vector<ByteRange>>& removals) {
+
+    // offsets after removed ranges move down by lengths of all of them;
+    // before[i] is the length of first i ranges
+    vector<size_t> before;
+
+    auto moved = [&before](const vector<ByteRange>& removed, unsigned long offset) {
+        return before[lower_bound(removed.begin(), removed.end(), offset, [](const ByteRange& range, unsigned long offset) {
+            return range.offset < offset;
+        }) - removed.begin()];
+    };
+
+    for (IdSection idSection = 0; idSection < removals.size(); idSection++) {
+
+        vector<ByteRange>& removed = removals[idSection];
+
+        if (removed.empty())
+            continue;
+
+        before.assign(1, 0);
+        for (const ByteRange& range : removed)
+            before.push_back(before.back() + range.length);
+
+        machineCode[idSection].remove(removed);
+
+        sectionTable->getEntryByID(idSection)->length -= before.back();
+
+        for (IdSymbol id = 0; id < symbolTable->getIdBound(); id++)
+            if (symbolTable->exists(id) && symbolTable->isLabel(id) && symbolTable->getSection(id) == idSection)
+                symbolTable->define(id, symbolTable->getValue(id) - moved(removed, symbolTable->getValue(id)));
+
+        for (SymbolFixups& chain : fixups)
+            for (SymbolReference* curr = chain.first; curr; curr = curr->next)
+                if (curr->inSection == idSection && !curr->removed) {
+                    curr->nextInstructionLC -= moved(removed, curr->nextInstructionLC);
+                    curr->patch -= moved(removed, curr->patch);
+                }
+
+        removed.clear();
+
+    }
+
+}
+
+bool Assembler::isPlaced(IdSection idSection) {
+    return idSection != 0 && sectionTable->getEntryByID(idSection)->address != ASM_UNDEFINED;
+}
+
+unsigned long Assembler::getAddress(IdSection idSection) {
+    return sectionTable->getEntryByID(idSection)->address;
+}
+
 void Assembler::backpatching() {
 
-    struct SymbolReference *prev = nullptr, *curr = symbolReferenceElemFirst;
-    SymbolEntry *symbol = nullptr;
+    // whatever is left in the chains, in order references were made;
+    // sections are never reopened, so that is order of (section, patch)
+    vector<SymbolReference*> pending;
+
+    for (SymbolFixups& chain: fixups)
+        for (SymbolReference* curr = chain.first; curr; curr = curr->next)
+            if (!curr->removed)
+                pending.push_back(curr);
+
+    sort(pending.begin(), pending.end(), [](const SymbolReference* a, const SymbolReference* b) {
+        return a->inSection != b->inSection ? a->inSection < b->inSection : a->patch < b->patch;
+    });
+
+    IdSymbol symbol = 0;
+    IdSection section = 0;
+    Scope scope = Scope::LOCAL;
     uint16_t t = 0;
 
-    while (curr) {
+    for (SymbolReference* curr: pending) {
 
         t = 0;
 
-        symbol = symbolTable->getEntryByName(curr->symbol);
+        symbol = symbolTable->getIdByName(curr->symbol);
 
-        if (symbol == nullptr)
-            throw AssemblyException("Unsuccessful backpatching - symbol '" + curr->symbol + "' is not defined.");
+        if (symbol == ASM_UNDEFINED)
+            throw AssemblyException("Unsuccessful backpatching - symbol '" + strings->getString(curr->symbol) + "' is not defined.");
 
-        if ((symbol->scope == Scope::LOCAL || symbol->scope == Scope::GLOBAL) && !symbol->defined)
-            throw AssemblyException("Unsuccessful backpatching - symbol '" + symbol->name + "' is not defined.");
+        section = symbolTable->getSection(symbol);
+        scope = symbolTable->getScope(symbol);
+
+        if ((scope == Scope::LOCAL || scope == Scope::GLOBAL) && !symbolTable->isDefined(symbol))
+            throw AssemblyException("Unsuccessful backpatching - symbol '" + strings->getString(curr->symbol) + "' is not defined.");
 
         if (curr->relocationType == RelocationType::R_386_PC16) {
 
-            if (symbol->section == curr->inSection)
-                t = symbol->value - curr->nextInstructionLC;
-            else if (symbol->scope == Scope::LOCAL) {
-                t = symbol->value - 2;
+            if (section == curr->inSection)
+                t = symbolTable->getValue(symbol) - curr->nextInstructionLC;
+            else if (scope != Scope::EXTERN && isPlaced(section) && isPlaced(curr->inSection))
+                t = (getAddress(section) + symbolTable->getValue(symbol)) - (getAddress(curr->inSection) + curr->nextInstructionLC);
+            else if (scope == Scope::LOCAL) {
+                t = symbolTable->getValue(symbol) - 2;
                 relocationTable->insertRelocation(
                     curr->inSection,
                     curr->patch, 
                     RelocationType::R_386_PC16, 
-                    sectionTable->getEntryByID(symbol->section)->SymbolEntryNo
+                    sectionTable->getEntryByID(section)->SymbolEntryNo
                 );
             } else { // Scope::GLOBAL || Scope::EXTERN
                 t = -2;
@@ -588,19 +1054,21 @@ void Assembler::backpatching() {
                     curr->inSection,
                     curr->patch,
                     RelocationType::R_386_PC16,
-                    symbol->entryNo
+                    symbol
                 );
             }
 
         } else { // RelocationType::R_386_16
         
-            if (symbol->scope == Scope::LOCAL) {
-                t = symbol->value;
+            if (scope != Scope::EXTERN && isPlaced(section))
+                t = getAddress(section) + symbolTable->getValue(symbol);
+            else if (scope == Scope::LOCAL) {
+                t = symbolTable->getValue(symbol);
                 relocationTable->insertRelocation(
                     curr->inSection,
                     curr->patch,
                     RelocationType::R_386_16,
-                    sectionTable->getEntryByID(symbol->section)->SymbolEntryNo
+                    sectionTable->getEntryByID(section)->SymbolEntryNo
                 );
             } else { // Scope::GLOBAL || Scope::EXTERN
                 t = 0;
@@ -608,628 +1076,456 @@ void Assembler::backpatching() {
                     curr->inSection,
                     curr->patch,
                     RelocationType::R_386_16,
-                    symbol->entryNo
+                    symbol
                 );
             }
 
         }
 
-        if (curr->modifyOneByte) {
-            machineCode[curr->inSection][curr->patch] = ((uint8_t)t & 0xFF);
-        } else {
-            machineCode[curr->inSection][curr->patch] = t & 0xFF;
-            machineCode[curr->inSection][curr->patch + 1] = (t >> 8) & 0xFF;
-        }
-
-        prev = curr;
-        curr = curr->next;
-        delete prev;
+        patchMachineCode(curr->inSection, curr->patch, t, curr->modifyOneByte);
 
     }
 
+    fixups.clear();
+
 }
 
-void Assembler::referencingSymbol(
-    string symbolString, 
+SymbolReference* Assembler::referencingSymbol(
+    IdAtom symbol, 
     IdSection inSection, 
     unsigned long patch,
     RelocationType relocationType,
     unsigned long nextInstrToExecuteLC,
     bool modifyOneByte
 ) {
-    SymbolReference* temp = new SymbolReference(symbolString, inSection, patch, relocationType, nextInstrToExecuteLC, modifyOneByte);
-    if (symbolReferenceElemFirst == nullptr)
-        symbolReferenceElemLast = symbolReferenceElemFirst = temp;
+    if (symbol >= fixups.size())
+        fixups.resize(symbol + 1);
+
+    SymbolFixups& chain = fixups[symbol];
+
+    SymbolReference* temp = references->create(symbol, inSection, patch, relocationType, nextInstrToExecuteLC, modifyOneByte);
+    if (chain.first == nullptr)
+        chain.last = chain.first = temp;
     else
-        symbolReferenceElemLast = symbolReferenceElemLast->next = temp;
+        chain.last = chain.last->next = temp;
+
+    return temp;
 }
 
-bool Assembler::isClassificationIndexOk(string symbol, string expression) {
-    
-    map<IdSection, unsigned long> hashMap;
+bool Assembler::resolvePCRelative(IdAtom symbol, IdSection inSection, unsigned long nextInstrToExecuteLC, long& value) {
 
-    for (IdSection idSection = 0; idSection < sectionTable->cntr; idSection++)
-        hashMap.insert({idSection, 0});
+    // code between the operand and the label may still shrink
+    if (mayShrink())
+        return false;
 
-    bool plus = false, minus = false;
+    IdSymbol id = symbolTable->getIdByName(symbol);
 
-    vector<Token> arithmeticTokens = Arithmetic::tokenize(expression);
+    // value of TNS symbol is known only after the pass
+    if (
+        id == ASM_UNDEFINED || 
+        !symbolTable->isDefined(id) || 
+        symbolTable->getSection(id) != inSection || 
+        tns->getIdByName(symbol) != ASM_UNDEFINED
+    )
+        return false;
 
-    for (Token& t: arithmeticTokens) {
+    value = symbolTable->getValue(id) - nextInstrToExecuteLC;
+    return true;
+}
 
-        if (
-            t.getType() == TokenType::DECIMAL ||
-            t.getType() == TokenType::HEXADECIMAL ||
-            t.getType() == TokenType::IMMEDIATE_DECIMAL ||
-            t.getType() == TokenType::IMMEDIATE_HEXADECIMAL
-        )  {
-            plus = false, minus = false;
-            continue;
-        }	
-        else if (t.getType() == TokenType::ARITHMETIC_OPERATOR) {
+void Assembler::applyLocalFixups(IdAtom symbol, IdSection section, unsigned long value) {
 
-            if (t.getValue() == "+") 
-                plus = true;
-            else 
-                minus = true;
-        
-        } else { // TokenType::IMMEDIATE_SYMBOL || TokenType::SYMBOL
-
-            if (symbolTable->getEntryByName(t.getValue()) == nullptr)
-                throw AssemblyException("Symbol '" + t.getValue() + "' is used in .equ directive, but is not defined");
-
-            if (symbolTable->getEntryByName(t.getValue())->section == 0) { // extern symbol
-                hashMap[0]++;
-                plus = false, minus = false;
-            } else if (plus) {
-                hashMap[symbolTable->getEntryByName(t.getValue())->section]++;
-                plus = false;
-            } else if (minus) {
-                hashMap[symbolTable->getEntryByName(t.getValue())->section]--;
-                minus = false;
-            } else // first token in this expression is symbol without sign before it
-                hashMap[symbolTable->getEntryByName(t.getValue())->section]++;
+    if (symbol >= fixups.size() || mayShrink())
+        return;
 
-        }
+    // PC relative references from the same section need no relocation,
+    // every other reference waits for backpatching
+    SymbolFixups& chain = fixups[symbol];
+    SymbolReference *prev = nullptr, *curr = chain.first;
 
-    }
+    while (curr) {
 
-    bool flagIsOk = true;
+        SymbolReference* next = curr->next;
 
-    for (IdSection idSection = 0; idSection < sectionTable->cntr; idSection++) {
+        if (curr->relocationType == RelocationType::R_386_PC16 && curr->inSection == section) {
 
-        if (hashMap[idSection] == 0)
-            continue;
-        else if (hashMap[idSection] == 1) {
+            patchMachineCode(section, curr->patch, value - curr->nextInstructionLC, curr->modifyOneByte);
 
-            if (!flagIsOk)
-                throw AssemblyException("Incorrect classification index for symbol '" + symbol + "'");
+            if (prev)
+                prev->next = next;
+            else
+                chain.first = next;
 
-            flagIsOk = false;
+            if (chain.last == curr)
+                chain.last = prev;
+
+            references->destroy(curr);
 
         } else
-            throw AssemblyException("Incorrect classification index for symbol '" + symbol + "'");
+            prev = curr;
 
-    }
-    
-    return true;
-}
+        curr = next;
 
-void Assembler::resolveTNSSymbols() {
+    }
 
-    for (TNSEntry& entry: tns->table)
-        isClassificationIndexOk(entry.name, entry.expression);
+}
 
-    bool end;
+void Assembler::patchMachineCode(IdSection idSection, unsigned long patch, uint16_t value, bool modifyOneByte) {
 
-    do {
+    if (modifyOneByte)
+        machineCode[idSection].patchByte(patch, (uint8_t)value & 0xFF);
+    else
+        machineCode[idSection].patchWord(patch, value);
 
-        end = true;
+}
 
-        for (size_t i = 0; i < tns->getSize(); i++)
-        {
-            try {
-                
-                TNSEntry* entry = tns->getEntryByID(unsigned(i));
-                vector<Token> arithmeticTokens = Arithmetic::convertToPostfix(Arithmetic::tokenize(entry->expression));
+bool Assembler::isClassificationIndexOk(IdAtom symbol, const Expression& expression) {
 
-                unsigned long v = Arithmetic::calculateSymbolValue(arithmeticTokens, symbolTable, entry->section);
+    for (const ExpressionTerm& term: expression)
+        if (term.type == TERM_SYMBOL && symbolTable->getIdByName(term.value) == ASM_UNDEFINED)
+            throw AssemblyException("Symbol '" + strings->getString(term.value) + "' is used in .equ directive, but is not defined");
 
-                symbolTable->getEntryByName(entry->name)->value = v;
-                symbolTable->getEntryByName(entry->name)->defined = true;
+    // every section has to add up to 0 or 1 and only one section may add up to 1,
+    // extern symbols are always counted as added to section 0
+    bool flagIsOk = true;
 
-                for (Token& t: arithmeticTokens)
-                    if ((t.getType() == TokenType::SYMBOL || t.getType() == TokenType::IMMEDIATE_SYMBOL) &&
-                        symbolTable->getEntryByName(t.getValue())->scope == Scope::EXTERN
-                    ) {
-                        symbolTable->getEntryByName(entry->name)->scope = Scope::EXTERN;
-                        break;
-                    }
+    for (size_t i = 0; i < expression.size(); i++) {
 
-                tns->deleteEntryByName(entry->name);
-                end = false;
-                break;
+        if (expression[i].type != TERM_SYMBOL)
+            continue;
 
-            } 
-            catch (const exception& ex)
-            {
-                ex.what();
-            }
-        
-        }
+        IdSection idSection = symbolTable->getSection(symbolTable->getIdByName(expression[i].value));
+        bool counted = false;
 
-        if (end && tns->getSize() > 0)
-            throw AssemblyException("Possible circular dependency between TNS symbols");
+        for (size_t j = 0; j < i && !counted; j++)
+            counted = expression[j].type == TERM_SYMBOL &&
+                symbolTable->getSection(symbolTable->getIdByName(expression[j].value)) == idSection;
 
-    } while (!end);
+        if (counted)
+            continue;
 
-}
+        long index = 0;
 
-bool Instruction::isInstructionJump(string instr) {
-    return instr == "jmp" || instr == "jeq" || instr == "jne" || instr == "jgt";
-};
+        for (size_t j = i; j < expression.size(); j++)
+            if (
+                expression[j].type == TERM_SYMBOL &&
+                symbolTable->getSection(symbolTable->getIdByName(expression[j].value)) == idSection
+            )
+                index += (idSection != 0 && expression[j].negative) ? -1 : 1;
 
-Instruction::Instruction (
-    queue<Token> instruction, 
-        unsigned long line, 
-        unsigned long locationCounter, 
-        IdSection currentSection,
-        Assembler* assembler
-) {
+        if (index == 0)
+            continue;
+        else if (index == 1) {
 
-    unsigned long sizeInBytes = Instruction::getInstructionSize(line, instruction);
+            if (!flagIsOk)
+                throw AssemblyException("Incorrect classification index for symbol '" + strings->getString(symbol) + "'");
 
-    Token mnemonic = instruction.front(); 
-    string mnemomicString = mnemonic.getValue();
+            flagIsOk = false;
 
-    queue<Token> params = instruction; params.pop();
-    int iterations = params.size();
+        } else
+            throw AssemblyException("Incorrect classification index for symbol '" + strings->getString(symbol) + "'");
 
-    OperandSize size = OperandSize::WORD;
-    if (mnemomicString[mnemomicString.size() - 1] == 'w') {
-        mnemomicString = mnemomicString.substr(0, mnemomicString.size() - 1);
-    } else if ((mnemomicString[mnemomicString.size() - 1] == 'b') && (mnemomicString != INSTRUCTION_SUB)) {
-        size = OperandSize::BYTE;
-        mnemomicString = mnemomicString.substr(0, mnemomicString.size() - 1);
     }
-
-    map<string, InstructionDetails>::iterator it = instructions.find(mnemomicString);
-
-    if (it == instructions.end())
-        throw AssemblyException("Inctruction '" + mnemomicString + "' does not exist", line);
     
-    if (instructions.at(mnemomicString).getNumberOfOperands() != params.size())
-        throw AssemblyException("Wrong number of operands in instruction '" + mnemomicString + "'", line);
-    
-    operationCode[0] = instructions.at(mnemomicString).getOperationCode() << 3;
-    operationCode[0] |= (size << 2);
-    instructionSize++;
-
-    int toWrite = 1;
-
-    bool destination = false;
-
-    if (params.size() == 2 && mnemomicString == INSTRUCTION_SHR)
-        destination = true;
-    else if (params.size() == 2)
-        destination = false;
-    else if (params.size() == 1 && mnemomicString == INSTRUCTION_POP)
-        destination = true;
-    else if (params.size() == 1)
-        destination = false;
-    
-    string offsetString;
-    string registerNumber;
-    Token offset;
-    long valueToWrite = 0;
-    int c = 0;
-    int mode = 0;
-    bool noOffset = false;
-    SymbolEntry *entry = nullptr;
+    return true;
+}
 
-    int i = 0;
+void Assembler::resolveTNSSymbols() {
 
-    while (i++ < iterations) {
+    for (TNSEntry& entry: tns->table)
+        isClassificationIndexOk(entry.name, entry.expression);
 
-        Token operand = params.front();
-        params.pop();
+    size_t size = tns->getSize();
 
-        switch (operand.getType()) {
+    // edge i -> j means that expression of entry i uses TNS symbol j,
+    // so j has to be calculated first
+    vector<vector<size_t>> dependencies(size);
 
-            case TokenType::SYMBOL:
-            case TokenType::DECIMAL:
-            case TokenType::HEXADECIMAL:
+    for (size_t i = 0; i < size; i++)
+        for (const ExpressionTerm& term: tns->getEntryByID(unsigned(i))->expression)
+            if (term.type == TERM_SYMBOL)
             {
+                unsigned long j = tns->getIdByName(term.value);
 
-                if (isInstructionJump(mnemomicString)) // immediate
-                    operationCode[toWrite++] = 0;
-                else // memory direct
-                    operationCode[toWrite++] = 4 << 5;
-                instructionSize++;
-
-                valueToWrite = 0;
-
-                if (operand.getType() == TokenType::HEXADECIMAL)
-                    valueToWrite = (unsigned long)strtol(operand.getValue().c_str(), 0, 16);
-                else if (operand.getType() == TokenType::DECIMAL)
-                    valueToWrite = stoul(operand.getValue());
-                else // TokenType::SYMBOL
-                {
-                    valueToWrite = 0;
-                    assembler->referencingSymbol(
-                        operand.getValue(),
-                        currentSection,
-                        locationCounter + toWrite,
-                        RelocationType::R_386_16,
-                        locationCounter + sizeInBytes,
-                        false
-                    );
-                }
-
-                operationCode[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
-                operationCode[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
-                instructionSize += 2;
+                if (j != ASM_UNDEFINED)
+                    dependencies[i].push_back(j);
             }
-            break;
 
-            case TokenType::REGISTER_INDIRECT:
-            {	
-                noOffset = false;
+    vector<vector<size_t>> components = stronglyConnectedComponents(dependencies);
 
-                if (operand.getValue().find('(') == 0) 
-                    noOffset = true;
-                else {
-                    offsetString = string(operand.getValue().substr(0, operand.getValue().find('(')));
-                    offset = Token::parse(offsetString, line, false);
-                }
+    string cycles;
 
-                registerNumber = operand.getValue().substr(operand.getValue().find("(") + 3, string::npos);
-                registerNumber = string(registerNumber.substr(0, registerNumber.size()-1));
-                if (registerNumber.at(registerNumber.size()-1) == 'h' || registerNumber.at(registerNumber.size()-1) == 'l')
-                    registerNumber = string(registerNumber.substr(0, registerNumber.size()-1));
-                
-                c = stoi(registerNumber);
+    for (vector<size_t>& component: components)
+    {
+        size_t first = component.front();
+        bool selfReference = false;
 
-                if (c == 15)
-                    throw AssemblyException("Using PSW register in indirect addressing mode is not allowed", line);
-                
-                if (c >= 8 || c < 0)
-                    throw AssemblyException("Specified register is not supported in this architecture", line);
-                
-                valueToWrite = 0;
+        for (size_t j: dependencies[first])
+            if (j == first)
+                selfReference = true;
 
-                if (offset.getType() == TokenType::HEXADECIMAL)
-                    valueToWrite = (unsigned long)strtol(offset.getValue().c_str(), 0, 16);
-                else if (offset.getType() == TokenType::DECIMAL)
-                    valueToWrite = stoul(offset.getValue());
-                else if (offset.getType() == TokenType::SYMBOL)
-                {
-                    valueToWrite = 0;
-                    assembler->referencingSymbol(
-                        offset.getValue(),
-                        currentSection,
-                        locationCounter + toWrite + 1,
-                        RelocationType::R_386_16,
-                        locationCounter + sizeInBytes,
-                        false
-                    );
-                }
+        if (component.size() == 1 && !selfReference)
+            continue;
 
-                if ((valueToWrite == 0 && offset.getType() != TokenType::SYMBOL) || noOffset)
-                {
-                    operationCode[toWrite++] = (2 << 5) | (c << 1);
-                    instructionSize++;
-                }
-                else
-                {
-                    operationCode[toWrite++] = (3 << 5) | (c << 1);
-                    instructionSize++;
+        sort(component.begin(), component.end());
 
-                    operationCode[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
-                    operationCode[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
-                    
-                    instructionSize += 2;
-                }
-            }
-            break;
+        cycles += cycles.empty() ? "" : "; ";
+        for (size_t k = 0; k < component.size(); k++)
+            cycles += (k > 0 ? ", " : "") + strings->getString(tns->getEntryByID(unsigned(component[k]))->name);
+    }
 
-            case TokenType::ASTERISK_DECIMAL:
-            case TokenType::ASTERISK_HEXADECIMAL:
-            case TokenType::ASTERISK_SYMBOL:
-            {
-                operationCode[toWrite++] = 4 << 5;
-                instructionSize++;
+    if (!cycles.empty())
+        throw AssemblyException("Circular dependency between TNS symbols: " + cycles);
 
-                offsetString = operand.getValue();
-                offset = Token::parse(offsetString, line, false);
+    // components come out in reverse topological order, dependencies first
+    for (vector<size_t>& component: components)
+    {
+        size_t i = component.front();
+        TNSEntry* entry = tns->getEntryByID(unsigned(i));
 
-                if (offset.getType() == TokenType::HEXADECIMAL)
-                    valueToWrite = (unsigned long)strtol(offsetString.c_str(), 0, 16);
-                else if (offset.getType() == TokenType::DECIMAL)
-                    valueToWrite = stoul(offsetString);
-                else if (operand.getType() == TokenType::SYMBOL)
-                {
-                    valueToWrite = 0;
-                    assembler->referencingSymbol(
-                        operand.getValue(),
-                        currentSection,
-                        locationCounter + toWrite,
-                        RelocationType::R_386_16,
-                        locationCounter + sizeInBytes,
-                        false
-                    );
-                }
+        unsigned long v = Arithmetic::calculateSymbolValue(entry->expression, symbolTable);
 
-                operationCode[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
-                operationCode[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
+        IdSymbol id = symbolTable->getIdByName(entry->name);
 
-                instructionSize += 2;
+        symbolTable->define(id, v);
+
+        for (const ExpressionTerm& term: entry->expression)
+            if (term.type == TERM_SYMBOL && symbolTable->getScope(symbolTable->getIdByName(term.value)) == Scope::EXTERN) {
+                symbolTable->setScope(id, Scope::EXTERN);
+                break;
             }
-            break;
+    }
 
-            case TokenType::REGISTER_DIRECT:
-            {
-                registerNumber = string(operand.getValue()).substr(2, string::npos);
-                if (registerNumber.at(registerNumber.size()-1) == 'h' || registerNumber.at(registerNumber.size()-1) == 'l')
-                    registerNumber = string(registerNumber.substr(0, registerNumber.size()-1));
+    tns->clear();
 
-                c = stoi(registerNumber);
-                mode = 0;
+}
 
-                if (destination && c == 15)
-                    throw AssemblyException("Writing to PSW register is not allowed", line);
+vector<vector<size_t>> Assembler::stronglyConnectedComponents(const vector<vector<size_t>>& graph) {
 
-                if (size == OperandSize::BYTE)
-                {
-                    if (operand.getValue().at(operand.getValue().size()-1) != 'h' &&
-                        operand.getValue().at(operand.getValue().size()-1) != 'l'
-                    )
-                        throw AssemblyException("Specify which byte you want to use (higer or lower byte)", line);
-                    
-                    if (operand.getValue().at(operand.getValue().size()-1) == 'h')
-                        mode = 1;
-                    else if (operand.getValue().at(operand.getValue().size()-1) == 'l')
-                        mode = 0;
-                }
-                else
-                {
-                
-                    if (operand.getValue().at(operand.getValue().size()-1) == 'h' &&
-                        operand.getValue().at(operand.getValue().size()-1) == 'l'
-                    )
-                        throw AssemblyException("If you use word as an operand, you should not specify which byte in that word you want to use", line);
+    // iterative Tarjan, long .equ chains would overflow the call stack
+    size_t size = graph.size();
+    size_t counter = 0;
 
-                }
+    vector<size_t> order(size, SIZE_MAX), lowLink(size, 0);
+    vector<bool> onStack(size, false);
+    vector<size_t> stack;
+    vector<pair<size_t, size_t>> calls;
+    vector<vector<size_t>> components;
 
-                if ((c >= 8 || c < 0) && c != 15)
-                    throw AssemblyException("Specified register is not supported in this architecture", line);
+    for (size_t root = 0; root < size; root++)
+    {
+        if (order[root] != SIZE_MAX)
+            continue;
 
-                operationCode[toWrite++] = (1 << 5) | (c << 1) | mode;
-                instructionSize++;
+        order[root] = lowLink[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = true;
+        calls.push_back({root, 0});
 
-            }
-            break;
+        while (!calls.empty())
+        {
+            size_t v = calls.back().first;
+            size_t& edge = calls.back().second;
 
-            case TokenType::IMMEDIATE_DECIMAL:
-            case TokenType::IMMEDIATE_HEXADECIMAL:
-            case TokenType::IMMEDIATE_SYMBOL:
+            if (edge < graph[v].size())
             {
-                if (destination)
-                    throw AssemblyException("Immediate value is specified as destination operand", line);
-
-                operationCode[toWrite++] = 0;
-                instructionSize++;
-
-                valueToWrite = 0;
+                size_t w = graph[v][edge++];
 
-                if (operand.getType() == TokenType::IMMEDIATE_HEXADECIMAL)
-                    valueToWrite = (unsigned long)strtol(operand.getValue().c_str(), 0, 16);
-                else if (operand.getType() == TokenType::IMMEDIATE_DECIMAL)
-                    valueToWrite = stoul(operand.getValue());
-                else if (operand.getType() == IMMEDIATE_SYMBOL)
+                if (order[w] == SIZE_MAX)
                 {
-                    valueToWrite = 0;
-                    assembler->referencingSymbol(
-                        operand.getValue(),
-                        currentSection,
-                        locationCounter + toWrite,
-                        RelocationType::R_386_16,
-                        locationCounter + sizeInBytes,
-                        size == OperandSize::BYTE ? true : false
-                    );
+                    order[w] = lowLink[w] = counter++;
+                    stack.push_back(w);
+                    onStack[w] = true;
+                    calls.push_back({w, 0});
                 }
+                else if (onStack[w])
+                    lowLink[v] = min(lowLink[v], order[w]);
 
-                if (size == OperandSize::BYTE)
-                {
-                    operationCode[toWrite++] = (uint8_t)valueToWrite;
-                    instructionSize++;
-                }
-                else
-                {
-                    operationCode[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
-                    operationCode[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
-                    instructionSize += 2;
-                }
-            }	
-            break;
-
-            case TokenType::PC_RELATIVE:
-            {
-
-                offsetString = operand.getValue().substr(0, operand.getValue().find('('));
+                continue;
+            }
 
-                operationCode[toWrite++] = ((3 << 5) | (7 << 1)); 
-                instructionSize++;
+            calls.pop_back();
 
-                valueToWrite = 0;
+            if (!calls.empty())
+                lowLink[calls.back().first] = min(lowLink[calls.back().first], lowLink[v]);
 
-                assembler->referencingSymbol(
-                    offsetString,
-                    currentSection,
-                    locationCounter + toWrite,
-                    RelocationType::R_386_PC16,
-                    locationCounter + sizeInBytes,
-                    false
-                );
+            if (lowLink[v] != order[v])
+                continue;
 
-                operationCode[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
-                operationCode[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
+            vector<size_t> component;
+            size_t w;
 
-                instructionSize += 2;
-            }
-            break;
-
-            default:
-                throw AssemblyException("Cannot code given instruction");
-            break;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                component.push_back(w);
+            } while (w != v);
 
+            components.push_back(component);
         }
-
-        destination = !destination;
-
     }
 
+    return components;
 }
 
-int Instruction::getInstructionSize(unsigned long line, queue<Token> _instruction)
+AddressingForm Instruction::getForm(const Operand& operand, const OperationDetails& operation)
 {
+    switch (operand.mode)
+    {
+        case OperandMode::MODE_VALUE:
+            if (operand.asterisk)
+                return FORM_MEMORY;
+            if (operand.immediate || operation.valueIsImmediate)
+                return FORM_IMMEDIATE;
+            return FORM_MEMORY;
+
+        case OperandMode::MODE_REGISTER_DIRECT:
+            return FORM_REGISTER_DIRECT;
+
+        case OperandMode::MODE_REGISTER_INDIRECT:
+            // zero offset is left out
+            if (operand.offsetKind == OffsetKind::OFFSET_NONE || (operand.offsetKind == OffsetKind::OFFSET_LITERAL && operand.value == 0))
+                return FORM_REGISTER_INDIRECT;
+            return FORM_REGISTER_INDIRECT_OFFSET;
+
+        case OperandMode::MODE_PC_RELATIVE:
+            return FORM_PC_RELATIVE;
+
+        default:
+            return NUMBER_OF_FORMS;
+    }
+}
 
-    int result = 0;
-
-    Token instrToken = _instruction.front();
-    _instruction.pop();
-    int iters = _instruction.size();
-
-    string instruction = instrToken.getValue();
-
-    OperandSize size = OperandSize::WORD;
+size_t Instruction::encode(
+    const Token& mnemonic,
+    const Token* operands,
+    size_t numberOfOperands,
+    unsigned long line, 
+    unsigned long locationCounter, 
+    IdSection currentSection,
+    Assembler* assembler,
+    uint8_t* output
+) {
 
-    if (instruction[instruction.size() - 1] == 'w') {
-        instruction = instruction.substr(0, instruction.size() - 1);
-    } else if ((instruction[instruction.size() - 1] == 'b') && (instruction != "sub")) {
-        size = OperandSize::BYTE;
-        instruction = instruction.substr(0, instruction.size() - 1);
-    }
+    const string& mnemomicString = mnemonic.getValue();
 
-    map<string, InstructionDetails>::iterator it = instructions.find(instruction);
+    const MnemonicDetails* details = Mnemonics::find(mnemomicString.data(), mnemomicString.size());
 
-    if (it == instructions.end())
-        throw AssemblyException("Instruction '" + instruction + "' does not exist", line);
+    if (details == nullptr)
+        throw AssemblyException("Instruction '" + mnemomicString + "' does not exist", line);
     
-    if (instructions.at(instruction).getNumberOfOperands() != _instruction.size())
-        throw AssemblyException("Wrong number of operands in instruction '" + instruction + "'", line);
-
-    result++;
+    if (details->numberOfOperands != numberOfOperands)
+        throw AssemblyException("Wrong number of operands in instruction '" + string(details->base) + "'", line);
     
-    string offset;
-    Token tokenOffset;
-    long toWrite;
+    OperandSize size = details->size;
+    const OperationDetails& operation = operationDetails[details->operationCode];
 
-    while (iters > 0)
+    // size is needed before any operand is written, PC relative values are relative to the next instruction
+    AddressingForm forms[2];
+    size_t sizeInBytes = 1;
+
+    for (size_t i = 0; i < details->numberOfOperands; i++)
     {
-        Token operand = _instruction.front();
-        _instruction.pop();
+        forms[i] = getForm(operands[i].getOperand(), operation);
 
-        switch (operand.getType())
-        {
-            case TokenType::REGISTER_DIRECT:
-            {
-                result++;
-                break;
-            }
+        if (forms[i] == NUMBER_OF_FORMS)
+            throw AssemblyException("Non-existent addressing mode", line);
 
-            case TokenType::IMMEDIATE_SYMBOL:
-            {
-                result++;
-                result += 2;
-                break;
-            }
+        sizeInBytes += 1 + formDetails[forms[i]].payload[size];
+    }
 
-            case TokenType::IMMEDIATE_DECIMAL:
-            case TokenType::IMMEDIATE_HEXADECIMAL:
-            {
-                result++;
+    output[0] = (details->operationCode << 3) | (size << 2);
 
-                if (size == OperandSize::BYTE)
-                    result++;
-                else
-                    result += 2;
-                break;
-            }
+    size_t toWrite = 1;
 
-            case TokenType::REGISTER_INDIRECT:
-            {
+    for (size_t i = 0; i < details->numberOfOperands; i++) {
 
-                bool noOffset = false;
+        const Operand& operand = operands[i].getOperand();
+        const FormDetails& form = formDetails[forms[i]];
+        bool destination = operation.destinations & OPERAND_DESTINATION(i);
 
-                if (operand.getValue().find('(') == 0) {
-                    noOffset = true;
-                } else {
-                    offset = operand.getValue().substr(0, operand.getValue().find('('));
-                    tokenOffset = Token::parse(offset, line, false);
-                }
+        if (destination && !form.destination)
+            throw AssemblyException("Immediate value is specified as destination operand", line);
 
-                toWrite = -1;
+        uint8_t registerNumber = operand.registerNumber;
+        uint8_t half = 0;
 
-                if (tokenOffset.getType() == TokenType::HEXADECIMAL)
-                    toWrite = (unsigned long)strtol(tokenOffset.getValue().c_str(), 0, 16);
-                else if (tokenOffset.getType() == TokenType::DECIMAL)
-                    toWrite = stoul(tokenOffset.getValue());
+        switch (forms[i])
+        {
+            case FORM_REGISTER_DIRECT:
+                if (destination && registerNumber == 15)
+                    throw AssemblyException("Writing to PSW register is not allowed", line);
 
+                if (size == OperandSize::BYTE && operand.half == RegisterHalf::HALF_NONE)
+                    throw AssemblyException("Specify which byte you want to use (higer or lower byte)", line);
 
-                if (noOffset ||
-                    ((tokenOffset.getType() == TokenType::DECIMAL || 
-                    tokenOffset.getType() == TokenType::HEXADECIMAL) 
-                    && toWrite == 0)
-                )
-                {
-                    result++;
-                }
-                else
-                {
-                    result++;
-                    result += 2;
-                }
+                half = size == OperandSize::BYTE && operand.half == RegisterHalf::HALF_HIGH;
+            break;
 
-                break;
+            case FORM_REGISTER_INDIRECT:
+            case FORM_REGISTER_INDIRECT_OFFSET:
+                if (registerNumber == 15)
+                    throw AssemblyException("Using PSW register in indirect addressing mode is not allowed", line);
+            break;
 
-            }
-            case TokenType::PC_RELATIVE:
-            {
-                result++;
-                result += 2;
-                break;
-            }
-            case TokenType::ASTERISK_DECIMAL:
-            case TokenType::ASTERISK_HEXADECIMAL:
-            case TokenType::ASTERISK_SYMBOL:
-            {
-                result++;
-                result += 2;
-                break;
-            }
+            case FORM_PC_RELATIVE:
+                registerNumber = 7;
+            break;
 
-            case TokenType::DECIMAL:
-            case TokenType::HEXADECIMAL:
-            case TokenType::SYMBOL:
-            {
+            default:
+                registerNumber = 0;
+            break;
+        }
 
-                result++;
-                result += 2;
+        output[toWrite++] = (form.mode << 5) | (registerNumber << 1) | half;
 
-                break;
-            }		
+        uint8_t payload = form.payload[size];
 
-            default:
+        if (payload == 0)
+            continue;
+
+        long valueToWrite = operand.offsetKind == OffsetKind::OFFSET_LITERAL ? operand.value : 0;
+
+        if (forms[i] == FORM_PC_RELATIVE)
+        {
+            if (!assembler->resolvePCRelative(operand.symbol, currentSection, locationCounter + sizeInBytes, valueToWrite))
             {
-                throw AssemblyException("Non-existent addressing mode", line);
-            }
+                SymbolReference* reference = assembler->referencingSymbol(
+                    operand.symbol,
+                    currentSection,
+                    locationCounter + toWrite,
+                    RelocationType::R_386_PC16,
+                    locationCounter + sizeInBytes,
+                    false
+                );
 
+                if (assembler->options.relax)
+                    assembler->relaxable.push_back(reference);
+            }
         }
+        else if (operand.offsetKind == OffsetKind::OFFSET_SYMBOL)
+        {
+            SymbolReference* reference = assembler->referencingSymbol(
+                operand.symbol,
+                currentSection,
+                locationCounter + toWrite,
+                RelocationType::R_386_16,
+                locationCounter + sizeInBytes,
+                payload == 1
+            );
+
+            if (assembler->options.relax && forms[i] == FORM_REGISTER_INDIRECT_OFFSET)
+                assembler->relaxable.push_back(reference);
+        }
+
+        output[toWrite++] = (uint8_t)(valueToWrite & 0xFF);
 
-        iters--;
+        if (payload == 2)
+            output[toWrite++] = (uint8_t)((valueToWrite >> 8) & 0xFF);
 
     }
 
-    return result;
+    return toWrite;
+
 }
@@ -2,12 +2,12 @@
 #define ASSEMBLER_H
 
 #define BYTES_INLINE 8
+#define SECTION_RESERVE_LIMIT (1 << 20)
+#define TEXT_ZERO_RUN_MINIMUM 0x100
+#define ADDRESS_SPACE_SIZE 0x10000
 
 #define START_SECTION -1
 
-#define COMMENT_SYMBOL '#'
-#define DELIMITER "\t\n, "
-
 #define DIRECTIVE_END ".end"
 #define DIRECTIVE_BYTE ".byte"
 #define DIRECTIVE_WORD ".word"
@@ -15,12 +15,10 @@
 #define DIRECTIVE_EQU ".equ"
 #define MODIFIER_EXTERN ".extern"
 #define MODIFIER_GLOBAL ".global"
-#define INSTRUCTION_SUB "sub"
-#define INSTRUCTION_SHR "shr"
-#define INSTRUCTION_POP "pop"
 
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <queue>
 #include <string>
 #include <vector>
@@ -28,101 +26,142 @@
 
 #include "structures.h"
 #include "enums.h"
+#include "arena.h"
 #include "arithmetic.h"
+#include "binarywriter.h"
+#include "elfwriter.h"
+#include "mnemonics.h"
+#include "scanner.h"
+#include "section.h"
+#include "source.h"
 
 using namespace std;
 
 class Instruction;
 
-class InstructionDetails
+enum OutputFormat
 {
-private:
-    string mnemonic;
-    uint8_t operationCode;
-    uint8_t numberOfOperands;
-public:
-    InstructionDetails(string mnemonic, uint8_t operationCode, uint8_t numberOfOperands) :
-        mnemonic(mnemonic), operationCode(operationCode), numberOfOperands(numberOfOperands) {}
-    
-    string getMnemonic() const { return mnemonic; };
-    uint8_t getOperationCode() const { return operationCode; };
-    uint8_t getNumberOfOperands() const { return numberOfOperands; };
+    FORMAT_ELF,
+    FORMAT_TEXT,
+    FORMAT_BINARY,          // flat image of placed sections
+    FORMAT_BINARY_SECTIONS  // one file per section
+};
 
+struct AssemblerOptions
+{
+    OutputFormat format = FORMAT_ELF;
+    size_t maxMemory = 0; // bytes section buffers may keep on the heap, 0 means no limit
+
+    // load addresses of sections, references into these sections are resolved
+    // to final values and need no relocation (absolute mode)
+    map<string, unsigned long> sectionAddresses;
+
+    // drop displacements which turn out to be zero, until nothing more shrinks
+    bool relax = false;
+
+    // 1 removes instructions without effect (peephole), 0 leaves code as written
+    unsigned optimizationLevel = 0;
 };
 
-static map<string, InstructionDetails> instructions = {
-    {"halt", InstructionDetails("halt", 0, 0)},
-    {"iret", InstructionDetails("iret", 1, 0)},
-    {"ret", InstructionDetails("halt", 2, 0)},
-    {"int", InstructionDetails("int", 3, 1)},
-    {"call", InstructionDetails("call", 4, 1)},
-    {"jmp", InstructionDetails("jmp", 5, 1)},
-    {"jeq", InstructionDetails("jeq", 6, 1)},
-    {"jne", InstructionDetails("jne", 7, 1)},
-    {"jgt", InstructionDetails("jgt", 8, 1)},
-    {"push", InstructionDetails("push", 9, 1)},
-    {"pop", InstructionDetails("pop", 10, 1)},
-    {"xchg", InstructionDetails("xchg", 11, 2)},
-    {"mov", InstructionDetails("mov", 12, 2)},
-    {"add", InstructionDetails("add", 13, 2)},
-    {"sub", InstructionDetails("sub", 14, 2)},
-    {"mul", InstructionDetails("mul", 15, 2)},
-    {"div", InstructionDetails("div", 16, 2)},
-    {"cmp", InstructionDetails("cmp", 17, 2)},
-    {"not", InstructionDetails("not", 18, 2)},
-    {"and", InstructionDetails("and", 19, 2)},
-    {"or", InstructionDetails("or", 20, 2)},
-    {"xor", InstructionDetails("xor", 21, 2)},
-    {"test", InstructionDetails("test", 22, 2)},
-    {"shl", InstructionDetails("shl", 23, 2)},
-    {"shr", InstructionDetails("shr", 24, 2)}
+// instruction as written into its section, kept only for the peephole optimizer
+struct EncodedInstruction
+{
+    unsigned long offset;
+    uint8_t size;
+};
+
+// instruction read back from section bytes
+struct DecodedInstruction
+{
+    uint8_t operationCode;
+    OperandSize size;
+    uint8_t numberOfOperands;
+    uint8_t mode[2];
+    uint8_t registerNumber[2];
+    uint8_t half[2];
+    unsigned long payload[2];   // section offset of bytes after the operand descriptor
 };
 
 class Assembler {
 public:
 
-    Assembler(string inputFile, string outputFile);
+    Assembler(string inputFile, string outputFile, AssemblerOptions options = AssemblerOptions());
     void generate();
     ~Assembler();
 
 private:
 
     void oneAndOnlyPass();
-    void loadLocally();
     void backpatching();
 
-    void writeToMachineCode(IdSection idSection, uint8_t byte);
-    void writeToMachineCode(IdSection idSection, Instruction instruction);
+    void optimize();
+    size_t matchPeephole(IdSection idSection, size_t index, const vector<unsigned long>& labels, const vector<SymbolReference*>& pending);
+    DecodedInstruction decodeInstruction(IdSection idSection, const EncodedInstruction& instruction);
+    static SymbolReference* findReference(const vector<SymbolReference*>& pending, IdSection idSection, unsigned long patch);
+
+    void relax();
+    bool isZeroDisplacement(const SymbolReference* reference);
+    IdSymbol findLabel(IdAtom symbol);
+    void shrinkSections(vector<vector<ByteRange>>& removals);
+    bool mayShrink() const { return options.relax || options.optimizationLevel > 0; }
+
+    void placeSections();
+    bool isPlaced(IdSection idSection);
+    unsigned long getAddress(IdSection idSection);
+
     void writeToOutputFile();
+    void writeTextDump();
 
-    void referencingSymbol(
-        string symbolString, 
+    SymbolReference* referencingSymbol(
+        IdAtom symbol, 
         IdSection inSection, 
         unsigned long patch,
         RelocationType relocationType,
         unsigned long nextInstrToExecuteLC,
         bool modifyOneByte
     );
+    bool resolvePCRelative(IdAtom symbol, IdSection inSection, unsigned long nextInstrToExecuteLC, long& value);
+    void applyLocalFixups(IdAtom symbol, IdSection section, unsigned long value);
+    void patchMachineCode(IdSection idSection, unsigned long patch, uint16_t value, bool modifyOneByte);
 
-    void appendGlobalSymbolElem(string symbol);
-    void appendExternSymbolElem(string symbol);
+    void appendGlobalSymbolElem(IdAtom symbol);
+    void appendExternSymbolElem(IdAtom symbol);
     void resolveSymbols();
 
-    bool isClassificationIndexOk(string symbol, string expression);
+    bool isClassificationIndexOk(IdAtom symbol, const Expression& expression);
     void resolveTNSSymbols();
+    static vector<vector<size_t>> stronglyConnectedComponents(const vector<vector<size_t>>& graph);
+
+    AssemblerOptions options;
 
-    ifstream inputFile;
-    vector<vector<string>> assembly;
+    SourceFile source;
 
+    Arena* arena;
+    Pool<SymbolReference>* references;
+
+    StringPool* strings;
     SymbolTable* symbolTable;
     SectionTable* sectionTable;
     RelocationTable* relocationTable;
     TNSTable* tns;
     
-    map<IdSection, vector<uint8_t>> machineCode;
+    // shared by all section buffers, so it has to outlive them
+    MemoryBudget budget;
+
+    // indexed by section ID
+    vector<SectionBuffer> machineCode;
+    string outputPath;
     ofstream outputFile;
 
-    struct SymbolReference *symbolReferenceElemFirst = nullptr, *symbolReferenceElemLast = nullptr;
+    // indexed by atom of the referenced symbol
+    vector<SymbolFixups> fixups;
+
+    // references to displacements of register indirect and PC relative operands, in
+    // order they were made; relaxation drops those that turn out to be zero
+    vector<SymbolReference*> relaxable;
+
+    // indexed by section ID, instructions in order they were written; filled only with -O1
+    vector<vector<EncodedInstruction>> instructions;
     struct SymbolElement *globalSymbolFirst = nullptr, *globalSymbolLast = nullptr;
     struct SymbolElement *externSymbolFirst = nullptr, *externSymbolLast = nullptr;
 
@@ -133,23 +172,22 @@ private:
 class Instruction {
 public:
 
-    Instruction(
-        queue<Token> instruction, 
+    // writes the instruction into output, which has room for INSTRUCTION_MAXIMUM_SIZE
+    // bytes, and returns its size; operands are decoded by the lexer
+    static size_t encode(
+        const Token& mnemonic,
+        const Token* operands,
+        size_t numberOfOperands,
         unsigned long line, 
         unsigned long locationCounter, 
         IdSection currentSection,
-        Assembler* assembler
+        Assembler* assembler,
+        uint8_t* output
     );
-    
-    static int getInstructionSize(unsigned long line, queue<Token> instruction);
-    static bool isInstructionJump(string instruction);
-
-    friend class Assembler;
 
 private:
 
-    uint8_t operationCode[7] = { 0,0,0,0,0,0,0 };
-    uint8_t instructionSize = 0;
+    static AddressingForm getForm(const Operand& operand, const OperationDetails& operation);
 
 };
 
@@ -0,0 +1,135 @@
+#include "binarywriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+
+BinaryWriter::BinaryWriter(
+    StringPool* strings,
+    SectionTable* sectionTable,
+    RelocationTable* relocationTable,
+    const vector<SectionBuffer>& machineCode
+) : strings(strings),
+    sectionTable(sectionTable),
+    relocationTable(relocationTable),
+    machineCode(machineCode)
+{}
+
+void BinaryWriter::checkRelocations()
+{
+    for (IdSection idSection = 1; idSection < machineCode.size(); idSection++)
+    {
+        const vector<RelocationEntry>& relocations = relocationTable->getRelocations(idSection);
+
+        if (relocations.empty())
+            continue;
+
+        char offset[32];
+        snprintf(offset, sizeof(offset), "0x%lx", relocations.front().offset);
+
+        throw AssemblyException(
+            "Section '" + strings->getString(sectionTable->getEntryByID(idSection)->name) +
+            "' has unresolved reference at offset " + offset + ", binary output can't contain relocations"
+        );
+    }
+}
+
+int BinaryWriter::create(string path)
+{
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (file < 0)
+        throw AssemblyException("Unable to open output file '" + path + "'.");
+
+    return file;
+}
+
+void BinaryWriter::writeSection(int file, IdSection idSection, size_t position)
+{
+    const SectionBuffer& buffer = machineCode[idSection];
+    size_t offset = 0, skipped = 0;
+
+    // stored bytes between zero runs, a run is simply not written
+    auto extent = [&](size_t end) {
+        buffer.read(offset - skipped, end - skipped, [&](const uint8_t* bytes, size_t count) {
+            while (count > 0)
+            {
+                ssize_t written = pwrite(file, bytes, count, position + offset);
+
+                if (written <= 0)
+                    throw AssemblyException("Unable to write output file");
+
+                bytes += written;
+                count -= written;
+                offset += written;
+            }
+        });
+    };
+
+    for (const ZeroRun& run : buffer.getZeroRuns())
+    {
+        extent(run.offset);
+
+        offset = run.offset + run.length;
+        skipped += run.length;
+    }
+
+    extent(buffer.getSize());
+}
+
+void BinaryWriter::finish(int file, string path, size_t size)
+{
+    // holes at the end are not covered by any write
+    bool failed = ftruncate(file, size) != 0;
+
+    if (close(file) != 0 || failed)
+        throw AssemblyException("Unable to write output file '" + path + "'.");
+}
+
+void BinaryWriter::writeImage(string path)
+{
+    checkRelocations();
+
+    unsigned long base = ASM_UNDEFINED, end = 0;
+
+    for (IdSection idSection = 1; idSection < machineCode.size(); idSection++)
+    {
+        if (machineCode[idSection].isEmpty())
+            continue;
+
+        SectionEntry* entry = sectionTable->getEntryByID(idSection);
+
+        if (entry->address == ASM_UNDEFINED)
+            throw AssemblyException("Section '" + strings->getString(entry->name) + "' has no address, flat binary image needs every section placed");
+
+        base = min(base, entry->address);
+        end = max(end, entry->address + machineCode[idSection].getSize());
+    }
+
+    int file = create(path);
+
+    for (IdSection idSection = 1; idSection < machineCode.size(); idSection++)
+        if (!machineCode[idSection].isEmpty())
+            writeSection(file, idSection, sectionTable->getEntryByID(idSection)->address - base);
+
+    finish(file, path, base == ASM_UNDEFINED ? 0 : end - base);
+}
+
+void BinaryWriter::writeSections(string path)
+{
+    checkRelocations();
+
+    // path.section.bin for every section with contents
+    for (IdSection idSection = 1; idSection < machineCode.size(); idSection++)
+    {
+        if (machineCode[idSection].isEmpty())
+            continue;
+
+        string sectionPath = path + "." + strings->getString(sectionTable->getEntryByID(idSection)->name) + ".bin";
+        int file = create(sectionPath);
+
+        writeSection(file, idSection, 0);
+        finish(file, sectionPath, machineCode[idSection].getSize());
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef BINARYWRITER_H
+#define BINARYWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "structures.h"
+
+using namespace std;
+
+/*
+    Raw section bytes without any tables, for images which are loaded as they
+    are. Either one flat image, where every section is at its load address
+    relative to the lowest one, or one file per section. Bytes are written
+    with pwrite straight from the section buffers; gaps between sections and
+    zero runs are left as holes. References have to be fully resolved, so a
+    single remaining relocation is an error.
+*/
+
+class BinaryWriter
+{
+public:
+
+    BinaryWriter(
+        StringPool* strings,
+        SectionTable* sectionTable,
+        RelocationTable* relocationTable,
+        const vector<SectionBuffer>& machineCode
+    );
+
+    void writeImage(string path);
+    void writeSections(string path);
+
+private:
+
+    void checkRelocations();
+
+    int create(string path);
+    void writeSection(int file, IdSection idSection, size_t position);
+    void finish(int file, string path, size_t size);
+
+    StringPool* strings;
+    SectionTable* sectionTable;
+    RelocationTable* relocationTable;
+    const vector<SectionBuffer>& machineCode;
+
+};
+
+#endif
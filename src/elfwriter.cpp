@@ -0,0 +1,257 @@
+#include "elfwriter.h"
+
+#include <string.h>
+
+#include "exceptions.h"
+
+ElfWriter::ElfWriter(
+    StringPool* strings,
+    SymbolTable* symbolTable,
+    SectionTable* sectionTable,
+    RelocationTable* relocationTable,
+    const vector<SectionBuffer>& machineCode
+) : strings(strings),
+    symbolTable(symbolTable),
+    sectionTable(sectionTable),
+    relocationTable(relocationTable),
+    machineCode(machineCode)
+{}
+
+Elf32_Word ElfWriter::addString(string& table, const string& value)
+{
+    Elf32_Word offset = table.size();
+
+    table += value;
+    table += '\0';
+
+    return offset;
+}
+
+void ElfWriter::buildSymbolTable()
+{
+    IdSymbol bound = symbolTable->getIdBound();
+    IdSection numberOfSections = sectionTable->GetSize();
+
+    vector<bool> isSectionSymbol(bound, false);
+    for (IdSection idSection = 1; idSection < numberOfSections; idSection++)
+        isSectionSymbol[sectionTable->getEntryByID(idSection)->SymbolEntryNo] = true;
+
+    symbolIndex.assign(bound, 0);
+    symbolNames = string(1, '\0');
+
+    // symbol 0 is UND, it becomes the null symbol
+    Elf32_Sym null;
+    memset(&null, 0, sizeof(null));
+    symbols.push_back(null);
+
+    // ELF wants all local symbols before the global ones
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+            firstGlobal = symbols.size();
+
+        for (IdSymbol id = 1; id < bound; id++)
+        {
+            if (!symbolTable->exists(id) || (symbolTable->getScope(id) == Scope::LOCAL) != (pass == 0))
+                continue;
+
+            IdSection section = symbolTable->getSection(id);
+
+            Elf32_Sym symbol;
+            memset(&symbol, 0, sizeof(symbol));
+
+            if (isSectionSymbol[id])
+                symbol.st_info = ELF32_ST_INFO(STB_LOCAL, STT_SECTION);
+            else
+            {
+                symbol.st_name = addString(symbolNames, strings->getString(symbolTable->getName(id)));
+                symbol.st_value = symbolTable->getScope(id) == Scope::EXTERN && section == 0 ? 0 : symbolTable->getValue(id);
+                symbol.st_info = ELF32_ST_INFO(pass == 0 ? STB_LOCAL : STB_GLOBAL, STT_NOTYPE);
+            }
+
+            symbol.st_shndx = section == 0 ? SHN_UNDEF : (Elf32_Section)section;
+
+            symbolIndex[id] = symbols.size();
+            symbols.push_back(symbol);
+        }
+    }
+}
+
+void ElfWriter::writeSection(ofstream& output, IdSection idSection)
+{
+    if (idSection >= machineCode.size())
+        return;
+
+    const SectionBuffer& buffer = machineCode[idSection];
+    size_t offset = 0, skipped = 0;
+
+    // stored bytes from offset up to end
+    auto extent = [&](size_t end) {
+        buffer.read(offset - skipped, end - skipped, [&](const uint8_t* bytes, size_t count) {
+            output.write((const char*)bytes, count);
+        });
+    };
+
+    for (const ZeroRun& run : buffer.getZeroRuns())
+    {
+        extent(run.offset);
+
+        // skipping forward leaves a hole, reads back as zeros
+        output.seekp(run.length, ios::cur);
+
+        offset = run.offset + run.length;
+        skipped += run.length;
+    }
+
+    extent(buffer.getSize());
+}
+
+void ElfWriter::write(ofstream& output)
+{
+    buildSymbolTable();
+
+    IdSection numberOfSections = sectionTable->GetSize();
+
+    vector<Elf32_Shdr> headers(numberOfSections);
+    string sectionNames(1, '\0');
+
+    memset(headers.data(), 0, headers.size() * sizeof(Elf32_Shdr));
+
+    Elf32_Off offset = sizeof(Elf32_Ehdr);
+
+    for (IdSection idSection = 1; idSection < numberOfSections; idSection++)
+    {
+        SectionEntry* entry = sectionTable->getEntryByID(idSection);
+        Elf32_Shdr& header = headers[idSection];
+
+        header.sh_name = addString(sectionNames, strings->getString(entry->name));
+        header.sh_type = SHT_PROGBITS;
+        header.sh_flags = SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR;
+        header.sh_addr = entry->address != ASM_UNDEFINED ? entry->address : 0;
+        header.sh_offset = offset;
+        header.sh_size = idSection < machineCode.size() ? machineCode[idSection].getSize() : 0;
+        header.sh_addralign = 1;
+
+        offset += header.sh_size;
+    }
+
+    Elf32_Section symtabIndex = numberOfSections;
+    for (IdSection idSection = 1; idSection < numberOfSections; idSection++)
+        if (!relocationTable->getRelocations(idSection).empty())
+            symtabIndex++;
+
+    // relocation sections
+    vector<IdSection> relocated;
+    offset = (offset + 3) & ~3;
+
+    Elf32_Off tablesOffset = offset;
+
+    for (IdSection idSection = 1; idSection < numberOfSections; idSection++)
+    {
+        const vector<RelocationEntry>& relocations = relocationTable->getRelocations(idSection);
+
+        if (relocations.empty())
+            continue;
+
+        Elf32_Shdr header;
+        memset(&header, 0, sizeof(header));
+
+        header.sh_name = addString(sectionNames, ".rel." + strings->getString(sectionTable->getEntryByID(idSection)->name));
+        header.sh_type = SHT_REL;
+        header.sh_offset = offset;
+        header.sh_size = relocations.size() * sizeof(Elf32_Rel);
+        header.sh_link = symtabIndex;
+        header.sh_info = idSection;
+        header.sh_addralign = 4;
+        header.sh_entsize = sizeof(Elf32_Rel);
+
+        headers.push_back(header);
+        relocated.push_back(idSection);
+
+        offset += header.sh_size;
+    }
+
+    Elf32_Shdr symtab, strtab, shstrtab;
+    memset(&symtab, 0, sizeof(symtab));
+    memset(&strtab, 0, sizeof(strtab));
+    memset(&shstrtab, 0, sizeof(shstrtab));
+
+    symtab.sh_name = addString(sectionNames, ".symtab");
+    symtab.sh_type = SHT_SYMTAB;
+    symtab.sh_offset = offset;
+    symtab.sh_size = symbols.size() * sizeof(Elf32_Sym);
+    symtab.sh_link = symtabIndex + 1;
+    symtab.sh_info = firstGlobal;
+    symtab.sh_addralign = 4;
+    symtab.sh_entsize = sizeof(Elf32_Sym);
+    offset += symtab.sh_size;
+
+    strtab.sh_name = addString(sectionNames, ".strtab");
+    strtab.sh_type = SHT_STRTAB;
+    strtab.sh_offset = offset;
+    strtab.sh_size = symbolNames.size();
+    strtab.sh_addralign = 1;
+    offset += strtab.sh_size;
+
+    shstrtab.sh_name = addString(sectionNames, ".shstrtab");
+    shstrtab.sh_type = SHT_STRTAB;
+    shstrtab.sh_offset = offset;
+    shstrtab.sh_size = sectionNames.size();
+    shstrtab.sh_addralign = 1;
+    offset += shstrtab.sh_size;
+
+    headers.push_back(symtab);
+    headers.push_back(strtab);
+    headers.push_back(shstrtab);
+
+    offset = (offset + 3) & ~3;
+
+    Elf32_Ehdr elf;
+    memset(&elf, 0, sizeof(elf));
+
+    memcpy(elf.e_ident, ELFMAG, SELFMAG);
+    elf.e_ident[EI_CLASS] = ELFCLASS32;
+    elf.e_ident[EI_DATA] = ELFDATA2LSB;
+    elf.e_ident[EI_VERSION] = EV_CURRENT;
+    elf.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    elf.e_type = ET_REL;
+    elf.e_machine = EM_386;
+    elf.e_version = EV_CURRENT;
+    elf.e_shoff = offset;
+    elf.e_ehsize = sizeof(Elf32_Ehdr);
+    elf.e_shentsize = sizeof(Elf32_Shdr);
+    elf.e_shnum = headers.size();
+    elf.e_shstrndx = headers.size() - 1;
+
+    // contents in the same order as offsets were given out above
+    output.write((const char*)&elf, sizeof(elf));
+
+    for (IdSection idSection = 1; idSection < numberOfSections; idSection++)
+        writeSection(output, idSection);
+
+    output.seekp(tablesOffset, ios::beg);
+
+    for (IdSection idSection : relocated)
+        for (const RelocationEntry& entry : relocationTable->getRelocations(idSection))
+        {
+            Elf32_Rel relocation;
+
+            relocation.r_offset = entry.offset;
+            relocation.r_info = ELF32_R_INFO(
+                symbolIndex[entry.value],
+                entry.relocationType == RelocationType::R_386_PC16 ? ELF_R_386_PC16 : ELF_R_386_16
+            );
+
+            output.write((const char*)&relocation, sizeof(relocation));
+        }
+
+    output.write((const char*)symbols.data(), symtab.sh_size);
+    output.write(symbolNames.data(), symbolNames.size());
+    output.write(sectionNames.data(), sectionNames.size());
+
+    output.seekp(offset, ios::beg);
+    output.write((const char*)headers.data(), headers.size() * sizeof(Elf32_Shdr));
+
+    if (!output)
+        throw AssemblyException("Unable to write output file");
+}
@@ -0,0 +1,67 @@
+#ifndef ELFWRITER_H
+#define ELFWRITER_H
+
+#include <elf.h>
+
+// <elf.h> defines relocation types as macros, which would replace the
+// enumerators of RelocationType with the same names
+#undef R_386_16
+#undef R_386_PC16
+
+#define ELF_R_386_16 20
+#define ELF_R_386_PC16 21
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "structures.h"
+
+using namespace std;
+
+/*
+    Writes the assembled file as ELF32 relocatable object. Sections keep their
+    section IDs as ELF section indices (UND is the null section), and they are
+    followed by one .rel section per section with relocations, .symtab,
+    .strtab and .shstrtab. Relocation types have the names and numbers of
+    their i386 counterparts, so the object is marked EM_386. Layout is
+    computed first and the file is written front to back, section contents
+    straight from the section buffers with zero runs left as holes.
+*/
+
+class ElfWriter
+{
+public:
+
+    ElfWriter(
+        StringPool* strings,
+        SymbolTable* symbolTable,
+        SectionTable* sectionTable,
+        RelocationTable* relocationTable,
+        const vector<SectionBuffer>& machineCode
+    );
+
+    void write(ofstream& output);
+
+private:
+
+    void buildSymbolTable();
+    Elf32_Word addString(string& table, const string& value);
+
+    void writeSection(ofstream& output, IdSection idSection);
+
+    StringPool* strings;
+    SymbolTable* symbolTable;
+    SectionTable* sectionTable;
+    RelocationTable* relocationTable;
+    const vector<SectionBuffer>& machineCode;
+
+    vector<Elf32_Sym> symbols;
+    vector<Elf32_Word> symbolIndex; // ELF index of every symbol ID
+    Elf32_Word firstGlobal = 0;
+    string symbolNames;
+
+};
+
+#endif
@@ -6,6 +6,7 @@
 typedef unsigned long IdSymbol;
 typedef unsigned long IdSection;
 typedef unsigned long IdRelocation;
+typedef unsigned long IdAtom;
 
 enum Scope : int
 {
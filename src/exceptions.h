@@ -17,7 +17,7 @@ public:
     ~AssemblyException()
     {
         delete[] a[0];
-        delete a;
+        delete[] a;
     }
 
     const char* what() const noexcept override
@@ -49,7 +49,7 @@ private:
     string message;
     unsigned long line;
 
-    char** a = new char*[1];
+    char** a = new char*[1]();
     
 };
 
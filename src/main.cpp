@@ -1,4 +1,8 @@
+#include <ctype.h>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdlib.h>
 
 #include "token.h"
 #include "structures.h"
@@ -7,30 +11,162 @@
 #include "exceptions.h"
 #include "assembler.h"
 
+#define USAGE \
+    "Invalid call parameters. Syntax is assembler [-f elf|text|binary|sections] [--max-memory size[K|M|G]] " \
+    "[--section-start section=address]... [--placement placement_file] [--relax] [-O0|-O1] -o output_file input_file"
+
 using namespace std;
 
+// size with optional K, M or G suffix, 0 if it can't be read
+static size_t parseSize(const char* text)
+{
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+
+    if (end == text)
+        return 0;
+
+    switch (*end)
+    {
+        case 'K': case 'k': size <<= 10; end++; break;
+        case 'M': case 'm': size <<= 20; end++; break;
+        case 'G': case 'g': size <<= 30; end++; break;
+    }
+
+    return *end == '\0' ? size : 0;
+}
+
+// section names are case insensitive like the rest of the source, lexer folds them to lower case
+static bool addSectionAddress(AssemblerOptions& options, string name, string address)
+{
+    char* end;
+    unsigned long value = strtoul(address.c_str(), &end, 0);
+
+    if (name.empty() || address.empty() || *end != '\0' || value >= ADDRESS_SPACE_SIZE)
+        return false;
+
+    for (char& c : name)
+        c = tolower(c);
+
+    options.sectionAddresses[name] = value;
+    return true;
+}
+
+// one "section address" pair per line, # starts a comment
+static void readPlacement(AssemblerOptions& options, string path)
+{
+    ifstream file(path);
+
+    if (!file)
+        throw AssemblyException("Unable to open placement file '" + path + "'.");
+
+    string line;
+    unsigned long lineNumber = 0;
+
+    while (getline(file, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        istringstream fields(line);
+        string name, address, rest;
+
+        if (!(fields >> name))
+            continue;
+
+        if (!(fields >> address) || (fields >> rest) || !addSectionAddress(options, name, address))
+            throw AssemblyException("Incorrect placement in file '" + path + "'", lineNumber);
+    }
+}
+
 int main(int argc, char** argv) {
 
-    if (argc < 4)
+    string inputFile, outputFile, placementFile;
+    AssemblerOptions options;
+
+    for (int i = 1; i < argc; i++)
     {
-        cout << "Invalid call parameters. Syntax is assembler -o output_file input_file" << endl;
+        string argument = argv[i];
+
+        if (argument == "-o" && i + 1 < argc)
+            outputFile = argv[++i];
+        else if (argument == "-f" && i + 1 < argc)
+        {
+            string format = argv[++i];
+
+            if (format == "elf")
+                options.format = FORMAT_ELF;
+            else if (format == "text")
+                options.format = FORMAT_TEXT;
+            else if (format == "binary")
+                options.format = FORMAT_BINARY;
+            else if (format == "sections")
+                options.format = FORMAT_BINARY_SECTIONS;
+            else
+            {
+                cout << USAGE << endl;
+                return -1;
+            }
+        }
+        else if (argument == "--max-memory" && i + 1 < argc)
+        {
+            options.maxMemory = parseSize(argv[++i]);
+
+            if (options.maxMemory == 0)
+            {
+                cout << USAGE << endl;
+                return -1;
+            }
+        }
+        else if (argument == "--section-start" && i + 1 < argc)
+        {
+            string placement = argv[++i];
+            size_t equals = placement.find('=');
+
+            if (equals == string::npos || !addSectionAddress(options, placement.substr(0, equals), placement.substr(equals + 1)))
+            {
+                cout << USAGE << endl;
+                return -1;
+            }
+        }
+        else if (argument == "--placement" && i + 1 < argc)
+            placementFile = argv[++i];
+        else if (argument == "--relax")
+            options.relax = true;
+        else if (argument == "-O0" || argument == "-O1")
+            options.optimizationLevel = argument[2] - '0';
+        else if (inputFile.empty() && argument[0] != '-')
+            inputFile = argument;
+        else
+        {
+            cout << USAGE << endl;
+            return -1;
+        }
+    }
+
+    if (inputFile.empty() || outputFile.empty())
+    {
+        cout << USAGE << endl;
         return -1;
     }
 
     try
     {
-        if (string(argv[1]) == "-o")
+        // addresses on the command line take precedence over the file
+        if (!placementFile.empty())
         {
+            AssemblerOptions fromFile;
+            readPlacement(fromFile, placementFile);
+            options.sectionAddresses.insert(fromFile.sectionAddresses.begin(), fromFile.sectionAddresses.end());
+        }
 
-            Assembler* assembler = new Assembler(argv[3], argv[2]);
+        Assembler* assembler = new Assembler(inputFile, outputFile, options);
 
-            assembler->generate();
+        assembler->generate();
 
-            delete assembler;
+        delete assembler;
 
-            cout << "Output file is generated." << endl;
-        
-        }
+        cout << "Output file is generated." << endl;
 
         return 0;
     
@@ -46,4 +182,4 @@ int main(int argc, char** argv) {
 
     return 0;
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,264 @@
+#ifndef MNEMONICS_H
+#define MNEMONICS_H
+
+#define NUMBER_OF_MNEMONICS 57
+#define NUMBER_OF_OPERATION_CODES 25
+#define MNEMONIC_SLOTS 256
+#define INSTRUCTION_MAXIMUM_SIZE 7
+
+#define OPERATION_CODE_JMP 5
+#define OPERATION_CODE_JGT 8
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "enums.h"
+
+/*
+    Every form of every mnemonic (with and without b/w suffix) is listed once,
+    so neither lexer nor encoder has to strip suffixes before lookup. Slots of
+    the hash table are filled at compile time with a seed for which no two
+    mnemonics collide, so lookup is one hash, one slot read and one compare.
+*/
+
+struct MnemonicDetails
+{
+    const char* mnemonic;
+    const char* base;
+    uint8_t operationCode;
+    uint8_t numberOfOperands;
+    OperandSize size;
+};
+
+static constexpr MnemonicDetails mnemonicDetails[NUMBER_OF_MNEMONICS] = {
+    {"halt", "halt", 0, 0, OperandSize::WORD},
+    {"iret", "iret", 1, 0, OperandSize::WORD},
+    {"ret", "ret", 2, 0, OperandSize::WORD},
+    {"int", "int", 3, 1, OperandSize::WORD},
+    {"call", "call", 4, 1, OperandSize::WORD},
+    {"jmp", "jmp", 5, 1, OperandSize::WORD},
+    {"jeq", "jeq", 6, 1, OperandSize::WORD},
+    {"jne", "jne", 7, 1, OperandSize::WORD},
+    {"jgt", "jgt", 8, 1, OperandSize::WORD},
+
+    {"push", "push", 9, 1, OperandSize::WORD},
+    {"pushb", "push", 9, 1, OperandSize::BYTE},
+    {"pushw", "push", 9, 1, OperandSize::WORD},
+    {"pop", "pop", 10, 1, OperandSize::WORD},
+    {"popb", "pop", 10, 1, OperandSize::BYTE},
+    {"popw", "pop", 10, 1, OperandSize::WORD},
+    {"xchg", "xchg", 11, 2, OperandSize::WORD},
+    {"xchgb", "xchg", 11, 2, OperandSize::BYTE},
+    {"xchgw", "xchg", 11, 2, OperandSize::WORD},
+    {"mov", "mov", 12, 2, OperandSize::WORD},
+    {"movb", "mov", 12, 2, OperandSize::BYTE},
+    {"movw", "mov", 12, 2, OperandSize::WORD},
+    {"add", "add", 13, 2, OperandSize::WORD},
+    {"addb", "add", 13, 2, OperandSize::BYTE},
+    {"addw", "add", 13, 2, OperandSize::WORD},
+    // "sub" ends with 'b', but only "subb" is the byte form
+    {"sub", "sub", 14, 2, OperandSize::WORD},
+    {"subb", "sub", 14, 2, OperandSize::BYTE},
+    {"subw", "sub", 14, 2, OperandSize::WORD},
+    {"mul", "mul", 15, 2, OperandSize::WORD},
+    {"mulb", "mul", 15, 2, OperandSize::BYTE},
+    {"mulw", "mul", 15, 2, OperandSize::WORD},
+    {"div", "div", 16, 2, OperandSize::WORD},
+    {"divb", "div", 16, 2, OperandSize::BYTE},
+    {"divw", "div", 16, 2, OperandSize::WORD},
+    {"cmp", "cmp", 17, 2, OperandSize::WORD},
+    {"cmpb", "cmp", 17, 2, OperandSize::BYTE},
+    {"cmpw", "cmp", 17, 2, OperandSize::WORD},
+    {"not", "not", 18, 2, OperandSize::WORD},
+    {"notb", "not", 18, 2, OperandSize::BYTE},
+    {"notw", "not", 18, 2, OperandSize::WORD},
+    {"and", "and", 19, 2, OperandSize::WORD},
+    {"andb", "and", 19, 2, OperandSize::BYTE},
+    {"andw", "and", 19, 2, OperandSize::WORD},
+    {"or", "or", 20, 2, OperandSize::WORD},
+    {"orb", "or", 20, 2, OperandSize::BYTE},
+    {"orw", "or", 20, 2, OperandSize::WORD},
+    {"xor", "xor", 21, 2, OperandSize::WORD},
+    {"xorb", "xor", 21, 2, OperandSize::BYTE},
+    {"xorw", "xor", 21, 2, OperandSize::WORD},
+    {"test", "test", 22, 2, OperandSize::WORD},
+    {"testb", "test", 22, 2, OperandSize::BYTE},
+    {"testw", "test", 22, 2, OperandSize::WORD},
+    {"shl", "shl", 23, 2, OperandSize::WORD},
+    {"shlb", "shl", 23, 2, OperandSize::BYTE},
+    {"shlw", "shl", 23, 2, OperandSize::WORD},
+    {"shr", "shr", 24, 2, OperandSize::WORD},
+    {"shrb", "shr", 24, 2, OperandSize::BYTE},
+    {"shrw", "shr", 24, 2, OperandSize::WORD}
+};
+
+/*
+    Encoding is driven by two tables. The first says, for every operation
+    code, which operands are written to and whether a plain value operand is
+    an immediate (jump target) or a memory address; flags it sets are read
+    only by the peephole optimizer. The second gives, for
+    every addressing form and operand size, the addressing mode bits of the
+    operand descriptor and how many bytes of payload follow it. Size of an
+    instruction is then a sum of table reads over its operands.
+*/
+
+#define OPERAND_DESTINATION(i) (1 << (i))
+
+// bits of PSW
+#define FLAG_Z 0x1
+#define FLAG_O 0x2
+#define FLAG_C 0x4
+#define FLAG_N 0x8
+
+struct OperationDetails
+{
+    uint8_t destinations;   // OPERAND_DESTINATION bits
+    bool valueIsImmediate;  // plain value operand is immediate, not memory direct
+    uint8_t flags;          // FLAG bits the operation sets
+};
+
+static constexpr OperationDetails operationDetails[NUMBER_OF_OPERATION_CODES] = {
+    {0, false, 0},                                                          // halt
+    {0, false, FLAG_Z | FLAG_O | FLAG_C | FLAG_N},                          // iret
+    {0, false, 0},                                                          // ret
+    {0, false, 0},                                                          // int
+    {0, false, 0},                                                          // call
+    {0, true, 0},                                                           // jmp
+    {0, true, 0},                                                           // jeq
+    {0, true, 0},                                                           // jne
+    {0, true, 0},                                                           // jgt
+    {0, false, 0},                                                          // push
+    {OPERAND_DESTINATION(0), false, 0},                                     // pop
+    {OPERAND_DESTINATION(1), false, 0},                                     // xchg
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // mov
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_O | FLAG_C | FLAG_N},     // add
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_O | FLAG_C | FLAG_N},     // sub
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // mul
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // div
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_O | FLAG_C | FLAG_N},     // cmp
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // not
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // and
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // or
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // xor
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_N},                       // test
+    {OPERAND_DESTINATION(1), false, FLAG_Z | FLAG_C | FLAG_N},              // shl
+    {OPERAND_DESTINATION(0), false, FLAG_Z | FLAG_C | FLAG_N}               // shr
+};
+
+enum AddressingForm : uint8_t
+{
+    FORM_IMMEDIATE,
+    FORM_REGISTER_DIRECT,
+    FORM_REGISTER_INDIRECT,
+    FORM_REGISTER_INDIRECT_OFFSET,
+    FORM_MEMORY,
+    FORM_PC_RELATIVE,
+
+    NUMBER_OF_FORMS
+};
+
+struct FormDetails
+{
+    uint8_t mode;                   // addressing mode bits of the operand descriptor
+    uint8_t payload[2];             // bytes after the descriptor, indexed by OperandSize
+    bool destination;               // may be written to
+};
+
+static constexpr FormDetails formDetails[NUMBER_OF_FORMS] = {
+    {0, {1, 2}, false},             // $value, jump target
+    {1, {0, 0}, true},              // %rX
+    {2, {0, 0}, true},              // (%rX), 0(%rX)
+    {3, {2, 2}, true},              // offset(%rX)
+    {4, {2, 2}, true},              // *value, value
+    {3, {2, 2}, true}               // symbol(%r7)
+};
+
+class Mnemonics
+{
+public:
+
+    static constexpr uint32_t hash(const char* data, size_t size, uint32_t seed)
+    {
+        uint32_t h = seed;
+
+        // | 0x20 folds upper case letters, mnemonics consist only of letters
+        for (size_t i = 0; i < size; i++)
+            h = (h ^ (uint8_t)(data[i] | 0x20)) * 16777619u;
+
+        return (h ^ (h >> 16)) % MNEMONIC_SLOTS;
+    }
+
+    static constexpr size_t length(const char* data)
+    {
+        size_t size = 0;
+        while (data[size])
+            size++;
+        return size;
+    }
+
+    static constexpr bool equals(const char* data, size_t size, const char* mnemonic)
+    {
+        for (size_t i = 0; i < size; i++)
+            if (mnemonic[i] == '\0' || (char)(data[i] | 0x20) != mnemonic[i])
+                return false;
+
+        return mnemonic[size] == '\0';
+    }
+
+    static const MnemonicDetails* find(const char* data, size_t size);
+
+    static constexpr bool isJump(uint8_t operationCode)
+    {
+        return operationCode >= OPERATION_CODE_JMP && operationCode <= OPERATION_CODE_JGT;
+    }
+
+};
+
+struct MnemonicTable
+{
+    uint32_t seed;
+    int8_t slots[MNEMONIC_SLOTS];
+
+    constexpr MnemonicTable() : seed(0), slots()
+    {
+        for (seed = 2166136261u; ; seed++)
+            if (fill())
+                return;
+    }
+
+    constexpr bool fill()
+    {
+        for (int i = 0; i < MNEMONIC_SLOTS; i++)
+            slots[i] = -1;
+
+        for (int i = 0; i < NUMBER_OF_MNEMONICS; i++)
+        {
+            const char* mnemonic = mnemonicDetails[i].mnemonic;
+            uint32_t slot = Mnemonics::hash(mnemonic, Mnemonics::length(mnemonic), seed);
+
+            if (slots[slot] != -1)
+                return false;
+
+            slots[slot] = i;
+        }
+
+        return true;
+    }
+};
+
+static constexpr MnemonicTable mnemonicTable;
+
+inline const MnemonicDetails* Mnemonics::find(const char* data, size_t size)
+{
+    if (size == 0 || size > 5)
+        return nullptr;
+
+    int8_t index = mnemonicTable.slots[hash(data, size, mnemonicTable.seed)];
+
+    if (index < 0 || !equals(data, size, mnemonicDetails[index].mnemonic))
+        return nullptr;
+
+    return &mnemonicDetails[index];
+}
+
+#endif
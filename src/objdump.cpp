@@ -0,0 +1,269 @@
+#include <iostream>
+#include <stdlib.h>
+
+#include "exceptions.h"
+#include "objectfile.h"
+#include "textwriter.h"
+
+#define USAGE \
+    "Invalid call parameters. Syntax is objdump [-t] [-h] [-r] [-s] [--symbol name] [--at section:offset] object_file"
+
+using namespace std;
+
+static void writeSymbol(TextWriter& writer, const ObjectFile& object, const SymbolEntry& symbol)
+{
+    writer.column(symbol.entryNo);
+    writer.column(object.getName(symbol.name));
+
+    if (symbol.section != (IdSection)ASM_UNDEFINED)
+        writer.column(symbol.section);
+    else
+        writer.column("N/A");
+
+    writer.column(symbol.value);
+
+    if (symbol.scope == Scope::GLOBAL)
+        writer.column("GLOBAL");
+    else if (symbol.scope == Scope::EXTERN)
+        writer.column("EXTERN");
+    else
+        writer.column("LOCAL");
+
+    writer.character('\n');
+}
+
+static void writeSymbolHeader(TextWriter& writer)
+{
+    writer.column("EntryNumber");
+    writer.column("Name");
+    writer.column("SectionNumber");
+    writer.column("Value");
+    writer.column("Scope");
+    writer.character('\n');
+}
+
+static void writeRelocation(TextWriter& writer, const ObjectFile& object, const RelocationEntry& entry)
+{
+    writer.column(entry.offset);
+    writer.column(entry.relocationType == RelocationType::R_386_PC16 ? "R_386_PC16" : "R_386_16");
+    writer.column(entry.value);
+
+    // name of the symbol relocation refers to, symbols are indexed by their entry number
+    const vector<SymbolEntry>& symbols = object.getSymbols();
+    if (entry.value < symbols.size() && symbols[entry.value].entryNo == entry.value)
+        writer.text(object.getName(symbols[entry.value].name));
+
+    writer.character('\n');
+}
+
+static void writeRelocationHeader(TextWriter& writer)
+{
+    writer.column("Offset");
+    writer.column("RelocationType");
+    writer.column("Value");
+    writer.text("Symbol\n");
+}
+
+static void writeSymbols(TextWriter& writer, const ObjectFile& object)
+{
+    writer.text("<--Symbol table-->\n");
+    writeSymbolHeader(writer);
+
+    for (const SymbolEntry& symbol : object.getSymbols())
+        writeSymbol(writer, object, symbol);
+
+    writer.text("\n\n");
+}
+
+static void writeSections(TextWriter& writer, const ObjectFile& object)
+{
+    // like in the assembler's dump, addresses are there only for an object with placed sections
+    bool withAddresses = false;
+    for (const SectionEntry& section : object.getSections())
+        if (section.address != (unsigned long)ASM_UNDEFINED)
+            withAddresses = true;
+
+    writer.text("<--Section table-->\n");
+    writer.column("EntryNumber");
+    writer.column("Name");
+    writer.column("Length");
+    writer.column("SymbolEntryNumber");
+    if (withAddresses) // header above is two characters wider than its column
+    {
+        writer.text("  ");
+        writer.column("Address");
+    }
+    writer.character('\n');
+
+    for (const SectionEntry& section : object.getSections())
+    {
+        writer.column(section.entryNo);
+        writer.column(object.getName(section.name));
+        writer.column(section.length);
+        writer.column(section.SymbolEntryNo);
+        if (section.address != (unsigned long)ASM_UNDEFINED)
+        {
+            writer.text("    ");
+            writer.column(section.address);
+        }
+        writer.character('\n');
+    }
+
+    writer.text("\n\n");
+}
+
+static void writeRelocations(TextWriter& writer, const ObjectFile& object)
+{
+    for (const SectionEntry& section : object.getSections())
+    {
+        const vector<RelocationEntry>& relocations = object.getRelocations(section.entryNo);
+
+        if (relocations.empty())
+            continue;
+
+        writer.text("<--Relocations of section '");
+        writer.text(object.getName(section.name));
+        writer.text("'-->\n");
+        writeRelocationHeader(writer);
+
+        for (const RelocationEntry& entry : relocations)
+            writeRelocation(writer, object, entry);
+
+        writer.text("\n\n");
+    }
+}
+
+static void writeContents(TextWriter& writer, const ObjectFile& object)
+{
+    for (const SectionEntry& section : object.getSections())
+    {
+        const uint8_t* bytes = object.getBytes(section.entryNo);
+        size_t size = object.getSize(section.entryNo);
+
+        if (size == 0)
+            continue;
+
+        writer.text("<--Contents of section '");
+        writer.text(object.getName(section.name));
+        writer.text("'-->\n");
+
+        // offset of the line followed by its 8 bytes
+        for (size_t offset = 0; offset < size; offset += 8)
+        {
+            writer.column(offset);
+
+            size_t end = offset + 8 < size ? offset + 8 : size;
+            for (size_t i = offset; i < end; i++)
+                writer.byte(bytes[i], i + 1 == end ? '\n' : ' ');
+        }
+
+        writer.text("\n\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool symbols = false, sections = false, relocations = false, contents = false;
+    string inputFile, symbol, at;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+
+        if (argument == "-t")
+            symbols = true;
+        else if (argument == "-h")
+            sections = true;
+        else if (argument == "-r")
+            relocations = true;
+        else if (argument == "-s")
+            contents = true;
+        else if (argument == "--symbol" && i + 1 < argc)
+            symbol = argv[++i];
+        else if (argument == "--at" && i + 1 < argc)
+            at = argv[++i];
+        else if (inputFile.empty() && argument[0] != '-')
+            inputFile = argument;
+        else
+        {
+            cout << USAGE << endl;
+            return -1;
+        }
+    }
+
+    if (inputFile.empty())
+    {
+        cout << USAGE << endl;
+        return -1;
+    }
+
+    // without any selection whole object is written
+    if (!symbols && !sections && !relocations && !contents && symbol.empty() && at.empty())
+        symbols = sections = relocations = contents = true;
+
+    try
+    {
+        ObjectFile object;
+        object.load(inputFile);
+
+        TextWriter writer(cout);
+
+        if (symbols)
+            writeSymbols(writer, object);
+
+        if (sections)
+            writeSections(writer, object);
+
+        if (relocations)
+            writeRelocations(writer, object);
+
+        if (contents)
+            writeContents(writer, object);
+
+        if (!symbol.empty())
+        {
+            const SymbolEntry* entry = object.findSymbol(symbol);
+
+            if (entry == nullptr)
+                throw AssemblyException("Symbol '" + symbol + "' is not in the object file");
+
+            writeSymbolHeader(writer);
+            writeSymbol(writer, object, *entry);
+        }
+
+        if (!at.empty())
+        {
+            size_t colon = at.rfind(':');
+            char* end = nullptr;
+            unsigned long offset = colon == string::npos ? 0 : strtoul(at.c_str() + colon + 1, &end, 16);
+
+            if (colon == string::npos || end == at.c_str() + colon + 1 || *end != '\0')
+                throw AssemblyException("Location '" + at + "' is not in the form section:offset");
+
+            const SectionEntry* section = object.findSection(at.substr(0, colon));
+
+            if (section == nullptr)
+                throw AssemblyException("Section '" + at.substr(0, colon) + "' is not in the object file");
+
+            const RelocationEntry* entry = object.findRelocation(section->entryNo, offset);
+
+            if (entry == nullptr)
+                throw AssemblyException("No relocation at '" + at + "'");
+
+            writeRelocationHeader(writer);
+            writeRelocation(writer, object, *entry);
+        }
+
+        return 0;
+    }
+    catch (AssemblyException& ex)
+    {
+        cout << ex.what() << endl;
+    }
+    catch (exception& ex)
+    {
+        cout << ex.what() << endl;
+    }
+
+    return -1;
+}
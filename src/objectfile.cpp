@@ -0,0 +1,401 @@
+#include "objectfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfwriter.h"
+#include "exceptions.h"
+
+// (section, offset) as one key, sections and offsets both fit in 32 bits
+#define RELOCATION_KEY(section, offset) (((unsigned long)(section) << 32) | (uint32_t)(offset))
+
+struct HexValues
+{
+    int8_t values[256];
+
+    constexpr HexValues() : values()
+    {
+        for (int i = 0; i < 256; i++)
+            values[i] = -1;
+        for (int i = 0; i < 10; i++)
+            values['0' + i] = i;
+        for (int i = 0; i < 6; i++)
+            values['a' + i] = values['A' + i] = 10 + i;
+    }
+
+    int8_t operator[](uint8_t c) const { return values[c]; }
+};
+
+static constexpr HexValues hexValues;
+
+void ObjectFile::load(string path)
+{
+    file.open(path);
+
+    elf = file.getSize() >= SELFMAG && memcmp(file.getData(), ELFMAG, SELFMAG) == 0;
+
+    if (elf)
+        loadElf();
+    else
+        loadText();
+
+    buildIndices();
+}
+
+const vector<RelocationEntry>& ObjectFile::getRelocations(IdSection idSection) const
+{
+    static const vector<RelocationEntry> none;
+
+    if (idSection >= relocations.size())
+        return none;
+
+    return relocations[idSection];
+}
+
+const SymbolEntry* ObjectFile::findSymbol(string_view name) const
+{
+    unordered_map<IdAtom, size_t>::const_iterator it = symbolIndex.find(strings.find(name));
+    return it == symbolIndex.end() ? nullptr : &symbols[it->second];
+}
+
+const SectionEntry* ObjectFile::findSection(string_view name) const
+{
+    unordered_map<IdAtom, size_t>::const_iterator it = sectionIndex.find(strings.find(name));
+    return it == sectionIndex.end() ? nullptr : &sections[it->second];
+}
+
+const RelocationEntry* ObjectFile::findRelocation(IdSection idSection, unsigned long offset) const
+{
+    unordered_map<unsigned long, const RelocationEntry*>::const_iterator it = relocationIndex.find(RELOCATION_KEY(idSection, offset));
+    return it == relocationIndex.end() ? nullptr : it->second;
+}
+
+void ObjectFile::buildIndices()
+{
+    // first one wins, so a global symbol is not hidden by a later local one of the same name
+    for (size_t i = 0; i < symbols.size(); i++)
+        symbolIndex.insert({ symbols[i].name, i });
+
+    for (size_t i = 0; i < sections.size(); i++)
+        sectionIndex.insert({ sections[i].name, i });
+
+    for (IdSection idSection = 0; idSection < relocations.size(); idSection++)
+        for (const RelocationEntry& entry : relocations[idSection])
+            relocationIndex.insert({ RELOCATION_KEY(idSection, entry.offset), &entry });
+
+    bytes.resize(sections.size(), nullptr);
+    sizes.resize(sections.size(), 0);
+    relocations.resize(sections.size());
+}
+
+void ObjectFile::loadElf()
+{
+    const char* data = file.getData();
+    size_t size = file.getSize();
+
+    const Elf32_Ehdr* header = (const Elf32_Ehdr*)data;
+
+    if (
+        size < sizeof(Elf32_Ehdr) ||
+        header->e_ident[EI_CLASS] != ELFCLASS32 ||
+        header->e_ident[EI_DATA] != ELFDATA2LSB ||
+        header->e_shentsize != sizeof(Elf32_Shdr) ||
+        header->e_shoff + (size_t)header->e_shnum * sizeof(Elf32_Shdr) > size ||
+        header->e_shstrndx >= header->e_shnum
+    )
+        throw AssemblyException("Object file is not a 32-bit little endian ELF file");
+
+    const Elf32_Shdr* headers = (const Elf32_Shdr*)(data + header->e_shoff);
+
+    auto inside = [&](const Elf32_Shdr& section) {
+        return section.sh_type == SHT_NOBITS || (size_t)section.sh_offset + section.sh_size <= size;
+    };
+
+    // name must start inside the string table and end with NUL before the table does
+    auto nameAt = [&](const Elf32_Shdr& table, Elf32_Word offset) {
+        const char* name = data + table.sh_offset + offset;
+
+        if (offset >= table.sh_size || memchr(name, '\0', table.sh_size - offset) == nullptr)
+            throw AssemblyException("Name in object file is outside of its string table");
+
+        return name;
+    };
+
+    const Elf32_Shdr& sectionNames = headers[header->e_shstrndx];
+
+    if (header->e_shstrndx == SHN_UNDEF || sectionNames.sh_type != SHT_STRTAB || !inside(sectionNames))
+        throw AssemblyException("Section name table of object file is incorrect");
+
+    // ELF section index is used as section ID, null section is UND
+    sections.push_back(SectionEntry(0, strings.intern("UND"), 0));
+    sections.back().SymbolEntryNo = 0;
+
+    bytes.push_back(nullptr);
+    sizes.push_back(0);
+
+    for (Elf32_Half i = 1; i < header->e_shnum; i++)
+    {
+        if (!inside(headers[i]))
+            throw AssemblyException("Section of object file is outside of the file");
+
+        // assembler's sections come first, relocation and symbol tables follow them
+        if (headers[i].sh_type != SHT_PROGBITS && headers[i].sh_type != SHT_NOBITS)
+            continue;
+
+        if (i != sections.size())
+            throw AssemblyException("Sections of object file are out of order");
+
+        sections.push_back(SectionEntry(i, strings.intern(nameAt(sectionNames, headers[i].sh_name)), headers[i].sh_size));
+
+        if (headers[i].sh_addr != 0)
+            sections.back().address = headers[i].sh_addr;
+
+        bytes.push_back(headers[i].sh_type == SHT_NOBITS ? nullptr : (const uint8_t*)data + headers[i].sh_offset);
+        sizes.push_back(headers[i].sh_type == SHT_NOBITS ? 0 : headers[i].sh_size);
+    }
+
+    relocations.resize(sections.size());
+
+    for (Elf32_Half i = 1; i < header->e_shnum; i++)
+    {
+        const Elf32_Shdr& section = headers[i];
+
+        if (section.sh_type == SHT_SYMTAB)
+        {
+            if (section.sh_link == SHN_UNDEF || section.sh_link >= header->e_shnum || headers[section.sh_link].sh_type != SHT_STRTAB)
+                throw AssemblyException("Symbol table of object file has no string table");
+
+            const Elf32_Sym* entries = (const Elf32_Sym*)(data + section.sh_offset);
+            const Elf32_Shdr& names = headers[section.sh_link];
+
+            for (size_t j = 0; j < section.sh_size / sizeof(Elf32_Sym); j++)
+            {
+                const Elf32_Sym& symbol = entries[j];
+                IdSection idSection = symbol.st_shndx < sections.size() ? symbol.st_shndx : 0;
+
+                Scope scope = ELF32_ST_BIND(symbol.st_info) == STB_LOCAL ? Scope::LOCAL :
+                    (symbol.st_shndx == SHN_UNDEF ? Scope::EXTERN : Scope::GLOBAL);
+
+                IdAtom name;
+
+                if (j == 0)
+                    name = strings.intern("UND");
+                else if (ELF32_ST_TYPE(symbol.st_info) == STT_SECTION)
+                {
+                    name = sections[idSection].name;
+                    sections[idSection].SymbolEntryNo = j;
+                }
+                else
+                    name = strings.intern(nameAt(names, symbol.st_name));
+
+                symbols.push_back(SymbolEntry(j, name, idSection, symbol.st_value, j == 0 ? Scope::EXTERN : scope, symbol.st_shndx != SHN_UNDEF));
+            }
+        }
+
+        if (section.sh_type == SHT_REL && section.sh_info < sections.size())
+        {
+            const Elf32_Rel* entries = (const Elf32_Rel*)(data + section.sh_offset);
+
+            for (size_t j = 0; j < section.sh_size / sizeof(Elf32_Rel); j++)
+            {
+                if (entries[j].r_offset >= sections[section.sh_info].length)
+                    throw AssemblyException("Relocation of object file is outside of its section");
+
+                relocations[section.sh_info].push_back(RelocationEntry(
+                    section.sh_info,
+                    entries[j].r_offset,
+                    ELF32_R_TYPE(entries[j].r_info) == ELF_R_386_PC16 ? RelocationType::R_386_PC16 : RelocationType::R_386_16,
+                    ELF32_R_SYM(entries[j].r_info)
+                ));
+            }
+        }
+    }
+}
+
+// hexadecimal number of the text dump, with or without 0x prefix
+static unsigned long number(string_view field)
+{
+    if (field.size() > 2 && field[0] == '0' && (field[1] == 'x' || field[1] == 'X'))
+        field.remove_prefix(2);
+
+    if (field.empty())
+        throw AssemblyException("Incorrect number in text object file");
+
+    unsigned long value = 0;
+
+    for (char c : field)
+    {
+        int digit = hexValues[(uint8_t)c];
+
+        if (digit < 0)
+            throw AssemblyException("Incorrect number in text object file");
+
+        value = value << 4 | digit;
+    }
+
+    return value;
+}
+
+void ObjectFile::loadText()
+{
+    string_view text(file.getData(), file.getSize());
+
+    if (text.substr(0, 18) != "<--Symbol table-->")
+        throw AssemblyException("Object file is neither ELF file nor text dump of the assembler");
+
+    enum { NONE, SYMBOLS, SECTIONS, RELOCATIONS, CONTENTS } part = NONE;
+    IdSection current = 0;
+    bool header = false;
+
+    size_t position = 0;
+    vector<string_view> fields;
+
+    while (position < text.size())
+    {
+        size_t end = text.find('\n', position);
+        if (end == string_view::npos)
+            end = text.size();
+
+        string_view line = text.substr(position, end - position);
+        position = end + 1;
+
+        // fields separated by spaces
+        fields.clear();
+        for (size_t i = 0; i < line.size(); )
+        {
+            size_t start = line.find_first_not_of(' ', i);
+            if (start == string_view::npos)
+                break;
+            size_t stop = line.find(' ', start);
+            if (stop == string_view::npos)
+                stop = line.size();
+            fields.push_back(line.substr(start, stop - start));
+            i = stop;
+        }
+
+        if (line == "<--Symbol table-->")
+        {
+            part = SYMBOLS;
+            header = true;
+            continue;
+        }
+
+        if (line == "<--Section table-->")
+        {
+            part = SECTIONS;
+            header = true;
+            continue;
+        }
+
+        if (line.substr(0, 12) == "<--Section '" && line.size() > 16)
+        {
+            const SectionEntry* section = nullptr;
+            IdAtom name = strings.find(line.substr(12, line.size() - 16));
+
+            for (const SectionEntry& entry : sections)
+                if (entry.name == name)
+                    section = &entry;
+
+            if (section == nullptr)
+                throw AssemblyException("Contents of unknown section in text object file");
+
+            current = section->entryNo;
+            part = RELOCATIONS;
+            header = true;
+            continue;
+        }
+
+        if (fields.empty())
+        {
+            // relocation table of a section ends with an empty line, its contents follow
+            if (part == RELOCATIONS && !header)
+                part = CONTENTS;
+            else if (part != RELOCATIONS)
+                part = part == CONTENTS ? NONE : part;
+            continue;
+        }
+
+        if (header)
+        {
+            header = false;
+            continue;
+        }
+
+        switch (part)
+        {
+            case SYMBOLS:
+            {
+                if (fields.size() != 5)
+                    throw AssemblyException("Incorrect symbol in text object file");
+
+                Scope scope = fields[4] == "GLOBAL" ? Scope::GLOBAL : (fields[4] == "EXTERN" ? Scope::EXTERN : Scope::LOCAL);
+                IdSection section = fields[2] == "N/A" ? ASM_UNDEFINED : number(fields[2]);
+
+                symbols.push_back(SymbolEntry(number(fields[0]), strings.intern(fields[1]), section, number(fields[3]), scope, section != 0));
+            }
+            break;
+
+            case SECTIONS:
+            {
+                if (fields.size() != 4 && fields.size() != 5)
+                    throw AssemblyException("Incorrect section in text object file");
+
+                SectionEntry entry(number(fields[0]), strings.intern(fields[1]), number(fields[2]));
+                entry.SymbolEntryNo = number(fields[3]);
+
+                if (fields.size() == 5)
+                    entry.address = number(fields[4]);
+
+                if (entry.entryNo != sections.size())
+                    throw AssemblyException("Sections of text object file are out of order");
+
+                sections.push_back(entry);
+                relocations.resize(sections.size());
+                decoded.resize(sections.size());
+            }
+            break;
+
+            case RELOCATIONS:
+            {
+                if (fields.size() != 3)
+                    throw AssemblyException("Incorrect relocation in text object file");
+
+                relocations[current].push_back(RelocationEntry(
+                    current,
+                    number(fields[0]),
+                    fields[1] == "R_386_PC16" ? RelocationType::R_386_PC16 : RelocationType::R_386_16,
+                    number(fields[2])
+                ));
+            }
+            break;
+
+            case CONTENTS:
+            {
+                vector<uint8_t>& contents = decoded[current];
+
+                // long runs of zeros are written as "* 0x<count> zero bytes"
+                if (fields[0] == "*" && fields.size() == 4)
+                {
+                    contents.resize(contents.size() + number(fields[1]));
+                    break;
+                }
+
+                for (string_view field : fields)
+                    contents.push_back((uint8_t)number(field));
+            }
+            break;
+
+            default:
+            break;
+        }
+    }
+
+    bytes.resize(sections.size(), nullptr);
+    sizes.resize(sections.size(), 0);
+
+    for (IdSection idSection = 0; idSection < decoded.size(); idSection++)
+    {
+        bytes[idSection] = decoded[idSection].data();
+        sizes[idSection] = decoded[idSection].size();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef OBJECTFILE_H
+#define OBJECTFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "source.h"
+#include "structures.h"
+
+using namespace std;
+
+/*
+    Reads what the assembler wrote, ELF or text dump, into the same entry
+    shapes the assembler uses. The file is mapped once; ELF section contents
+    are used in place, text dump contents are decoded once. Symbols and
+    sections are found by name through the string pool and relocations by
+    (section, offset) through a hash, all in constant time.
+*/
+
+class ObjectFile
+{
+public:
+
+    void load(string path);
+
+    const vector<SymbolEntry>& getSymbols() const { return symbols; }
+    const vector<SectionEntry>& getSections() const { return sections; }
+    const vector<RelocationEntry>& getRelocations(IdSection idSection) const;
+
+    const SymbolEntry* findSymbol(string_view name) const;
+    const SectionEntry* findSection(string_view name) const;
+    const RelocationEntry* findRelocation(IdSection idSection, unsigned long offset) const;
+
+    // contents of the section, getSize bytes long
+    const uint8_t* getBytes(IdSection idSection) const { return bytes[idSection]; }
+    size_t getSize(IdSection idSection) const { return sizes[idSection]; }
+
+    const string& getName(IdAtom name) const { return strings.getString(name); }
+
+    bool isElf() const { return elf; }
+
+private:
+
+    void loadElf();
+    void loadText();
+    void buildIndices();
+
+    SourceFile file;
+    StringPool strings;
+    bool elf = false;
+
+    vector<SymbolEntry> symbols;
+    vector<SectionEntry> sections;           // indexed by section ID
+    vector<vector<RelocationEntry>> relocations; // indexed by section ID
+
+    vector<const uint8_t*> bytes;
+    vector<size_t> sizes;
+    vector<vector<uint8_t>> decoded;         // contents read from text dump
+
+    unordered_map<IdAtom, size_t> symbolIndex;
+    unordered_map<IdAtom, size_t> sectionIndex;
+    unordered_map<unsigned long, const RelocationEntry*> relocationIndex;
+
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "scanner.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86
+#endif
+
+static inline uint32_t bitsFrom(unsigned position)
+{
+    return position >= SCANNER_BLOCK ? 0 : ~0u << position;
+}
+
+BlockMasks SourceScanner::classifyScalar(const char* block)
+{
+    BlockMasks masks = { 0, 0, 0, 0 };
+
+    for (unsigned i = 0; i < SCANNER_BLOCK; i++)
+    {
+        char c = block[i];
+
+        if (c == '\n')
+            masks.newline |= 1u << i;
+        else if (c == COMMENT_SYMBOL)
+            masks.comment |= 1u << i;
+        else if (c == ' ' || c == '\t' || c == ',')
+            masks.delimiter |= 1u << i;
+        else
+            masks.token |= 1u << i;
+    }
+
+    return masks;
+}
+
+#ifdef SCANNER_X86
+
+BlockMasks SourceScanner::classifySSE2(const char* block)
+{
+    BlockMasks masks;
+    uint32_t half[2][4];
+
+    for (int i = 0; i < 2; i++)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+
+        __m128i newline = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+        __m128i comment = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(COMMENT_SYMBOL));
+        __m128i delimiter = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))
+        );
+
+        half[i][0] = (uint16_t)_mm_movemask_epi8(newline);
+        half[i][1] = (uint16_t)_mm_movemask_epi8(comment);
+        half[i][2] = (uint16_t)_mm_movemask_epi8(delimiter);
+    }
+
+    masks.newline = half[0][0] | (half[1][0] << 16);
+    masks.comment = half[0][1] | (half[1][1] << 16);
+    masks.delimiter = half[0][2] | (half[1][2] << 16);
+    masks.token = ~(masks.newline | masks.comment | masks.delimiter);
+
+    return masks;
+}
+
+__attribute__((target("avx2")))
+BlockMasks SourceScanner::classifyAVX2(const char* block)
+{
+    BlockMasks masks;
+
+    __m256i bytes = _mm256_loadu_si256((const __m256i*)block);
+
+    __m256i newline = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+    __m256i comment = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(COMMENT_SYMBOL));
+    __m256i delimiter = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t'))),
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','))
+    );
+
+    masks.newline = (uint32_t)_mm256_movemask_epi8(newline);
+    masks.comment = (uint32_t)_mm256_movemask_epi8(comment);
+    masks.delimiter = (uint32_t)_mm256_movemask_epi8(delimiter);
+    masks.token = ~(masks.newline | masks.comment | masks.delimiter);
+
+    return masks;
+}
+
+#else
+
+BlockMasks SourceScanner::classifySSE2(const char* block)
+{
+    return classifyScalar(block);
+}
+
+BlockMasks SourceScanner::classifyAVX2(const char* block)
+{
+    return classifyScalar(block);
+}
+
+#endif
+
+SourceScanner::Classifier SourceScanner::selectClassifier()
+{
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return &SourceScanner::classifyAVX2;
+
+    if (__builtin_cpu_supports("sse2"))
+        return &SourceScanner::classifySSE2;
+#endif
+
+    return &SourceScanner::classifyScalar;
+}
+
+SourceScanner::SourceScanner(const char* data, size_t size) : data(data), size(size)
+{
+    static const Classifier selected = selectClassifier();
+
+    classify = selected;
+}
+
+void SourceScanner::classifyBlock(size_t blockBase)
+{
+    size_t remaining = size - blockBase;
+
+    if (remaining >= SCANNER_BLOCK)
+        masks = classify(data + blockBase);
+    else
+    {
+        // bytes past the end are padding, they must not become part of a token
+        char tail[SCANNER_BLOCK];
+
+        memset(tail, ' ', SCANNER_BLOCK);
+        memcpy(tail, data + blockBase, remaining);
+        masks = classify(tail);
+        masks.token &= (1u << remaining) - 1;
+    }
+
+    base = blockBase;
+    classified = true;
+}
+
+bool SourceScanner::nextLine(vector<string_view>& tokens)
+{
+    tokens.clear();
+
+    if (position >= size)
+        return false;
+
+    // a line ends with a newline, so no comment or token is carried over from the previous one
+    bool inComment = false;
+    bool inToken = false;
+    size_t tokenBegin = 0;
+
+    for (size_t blockBase = position - position % SCANNER_BLOCK; blockBase < size; blockBase += SCANNER_BLOCK)
+    {
+        if (!classified || base != blockBase)
+            classifyBlock(blockBase);
+
+        uint32_t separator = masks.newline | masks.comment | masks.delimiter;
+        unsigned offset = blockBase < position ? position - blockBase : 0;
+
+        while (offset < SCANNER_BLOCK)
+        {
+            if (inComment)
+            {
+                uint32_t next = masks.newline & bitsFrom(offset);
+                if (next == 0)
+                    break;
+
+                offset = __builtin_ctz(next);
+                inComment = false;
+            }
+
+            if (inToken)
+            {
+                uint32_t next = separator & bitsFrom(offset);
+                if (next == 0)
+                    break;
+
+                offset = __builtin_ctz(next);
+                tokens.push_back(string_view(data + tokenBegin, blockBase + offset - tokenBegin));
+                inToken = false;
+            }
+
+            uint32_t event = (masks.newline | masks.comment | masks.token) & bitsFrom(offset);
+            if (event == 0)
+                break;
+
+            offset = __builtin_ctz(event);
+            uint32_t bit = 1u << offset;
+
+            // line ending with the last byte of the file does not start a new line
+            if (masks.newline & bit)
+            {
+                position = blockBase + offset + 1;
+                return true;
+            }
+
+            if (masks.comment & bit)
+                inComment = true;
+            else
+            {
+                inToken = true;
+                tokenBegin = blockBase + offset;
+            }
+
+            offset++;
+        }
+    }
+
+    if (inToken)
+        tokens.push_back(string_view(data + tokenBegin, size - tokenBegin));
+
+    position = size;
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#define SCANNER_BLOCK 32
+
+#define COMMENT_SYMBOL '#'
+#define DELIMITER "\t\n, "
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/*
+    Splits the source buffer into tokens one line at a time, so only the
+    tokens of the current line are ever held. Every block of SCANNER_BLOCK
+    bytes is classified at once (AVX2 or SSE2 when available, scalar
+    otherwise) into bit masks of newlines, comment symbols, delimiters and
+    token bytes; token and line boundaries are then read from the masks
+    instead of being searched for byte by byte. The block the last line ended
+    in is kept, so a block is classified once even when it holds many lines.
+*/
+
+struct BlockMasks
+{
+    uint32_t newline;
+    uint32_t comment;
+    uint32_t delimiter;
+    uint32_t token;
+};
+
+class SourceScanner
+{
+public:
+
+    SourceScanner(const char* data, size_t size);
+
+    // tokens receives views into data of the next line, false when there are no more lines
+    bool nextLine(vector<string_view>& tokens);
+
+    // offset of the first byte not yet scanned
+    size_t getPosition() const { return position; }
+
+private:
+
+    typedef BlockMasks (*Classifier)(const char* block);
+
+    static Classifier selectClassifier();
+
+    static BlockMasks classifyScalar(const char* block);
+    static BlockMasks classifySSE2(const char* block);
+    static BlockMasks classifyAVX2(const char* block);
+
+    void classifyBlock(size_t blockBase);
+
+    Classifier classify;
+
+    const char* data;
+    size_t size;
+    size_t position = 0;
+
+    // masks of the block starting at base, valid once classified
+    BlockMasks masks;
+    size_t base = 0;
+    bool classified = false;
+
+};
+
+#endif
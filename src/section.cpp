@@ -0,0 +1,265 @@
+#include "section.h"
+
+#include <fcntl.h>
+#include <new>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+#include "exceptions.h"
+
+SectionBuffer::~SectionBuffer()
+{
+    release();
+}
+
+void SectionBuffer::release()
+{
+    if (file >= 0)
+    {
+        if (data)
+            munmap(data, capacity);
+        close(file);
+    }
+    else
+    {
+        free(data);
+
+        if (budget)
+            budget->used -= capacity;
+    }
+
+    data = nullptr;
+    capacity = 0;
+    file = -1;
+}
+
+SectionBuffer::SectionBuffer(SectionBuffer&& other) :
+    data(other.data), size(other.size), capacity(other.capacity),
+    runs(move(other.runs)), skipped(other.skipped),
+    budget(other.budget), file(other.file)
+{
+    other.data = nullptr;
+    other.size = other.capacity = other.skipped = 0;
+    other.file = -1;
+}
+
+SectionBuffer& SectionBuffer::operator=(SectionBuffer&& other)
+{
+    if (this != &other)
+    {
+        release();
+
+        data = other.data;
+        size = other.size;
+        capacity = other.capacity;
+        runs = move(other.runs);
+        skipped = other.skipped;
+        budget = other.budget;
+        file = other.file;
+
+        other.data = nullptr;
+        other.size = other.capacity = other.skipped = 0;
+        other.file = -1;
+    }
+
+    return *this;
+}
+
+void SectionBuffer::reserve(size_t bytes)
+{
+    if (bytes <= capacity)
+        return;
+
+    if (file < 0 && budget && budget->limit && budget->used - capacity + bytes > budget->limit)
+    {
+        spill(bytes);
+        return;
+    }
+
+    if (file >= 0)
+    {
+        // the file keeps the bytes, mapping is simply made again over the longer file
+        if (ftruncate(file, bytes) != 0)
+            throw AssemblyException("Unable to extend temporary file of section buffer");
+
+        munmap(data, capacity);
+        data = nullptr;
+        capacity = 0;
+
+        void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+        if (mapping == MAP_FAILED)
+            throw AssemblyException("Unable to map temporary file of section buffer");
+
+        data = (uint8_t*)mapping;
+        capacity = bytes;
+        return;
+    }
+
+    uint8_t* grown = (uint8_t*)realloc(data, bytes);
+
+    if (grown == nullptr)
+        throw bad_alloc();
+
+    if (budget)
+        budget->used += bytes - capacity;
+
+    data = grown;
+    capacity = bytes;
+}
+
+void SectionBuffer::spill(size_t bytes)
+{
+    const char* directory = getenv("TMPDIR");
+    string path = string(directory && *directory ? directory : "/tmp") + "/assembler-section-XXXXXX";
+
+    int descriptor = mkstemp(&path[0]);
+
+    if (descriptor < 0)
+        throw AssemblyException("Unable to create temporary file for section buffer");
+
+    // nobody else needs the name, file is removed once it is closed
+    unlink(path.c_str());
+
+    // bytes so far go into the file, not through the mapping, so they are not in memory twice
+    size_t written = 0;
+
+    while (written < size)
+    {
+        ssize_t count = pwrite(descriptor, data + written, size - written, written);
+
+        if (count <= 0)
+        {
+            close(descriptor);
+            throw AssemblyException("Unable to write temporary file for section buffer");
+        }
+
+        written += count;
+    }
+
+    void* mapping = MAP_FAILED;
+
+    if (ftruncate(descriptor, bytes) == 0)
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        close(descriptor);
+        throw AssemblyException("Unable to map temporary file for section buffer");
+    }
+
+    free(data);
+    budget->used -= capacity;
+
+    data = (uint8_t*)mapping;
+    capacity = bytes;
+    file = descriptor;
+}
+
+void SectionBuffer::evict(size_t from, size_t to) const
+{
+    if (file < 0)
+        return;
+
+    static const size_t page = sysconf(_SC_PAGESIZE);
+
+    from -= from % page;
+    to -= to % page;
+
+    // shared mapping of the file, dropped pages are read back from it if touched again
+    if (to > from)
+        madvise(data + from, to - from, MADV_DONTNEED);
+}
+
+void SectionBuffer::grow(size_t count)
+{
+    size_t bytes = capacity < SECTION_BUFFER_MINIMUM ? SECTION_BUFFER_MINIMUM : capacity * 2;
+
+    // pages written so far leave memory with the old mapping, so no more than the budget stays mapped
+    if (file >= 0)
+        bytes = capacity + budget->limit;
+
+    while (bytes < size + count)
+        bytes *= 2;
+
+    reserve(bytes);
+}
+
+void SectionBuffer::appendZeros(size_t count)
+{
+    if (count < SECTION_ZERO_RUN_MINIMUM)
+    {
+        if (size + count > capacity)
+            grow(count);
+        memset(data + size, 0, count);
+        size += count;
+        return;
+    }
+
+    // run right after another run is merged into it
+    if (!runs.empty() && runs.back().offset + runs.back().length == getSize())
+        runs.back().length += count;
+    else
+        runs.push_back({getSize(), count, skipped});
+
+    skipped += count;
+}
+
+void SectionBuffer::remove(const vector<ByteRange>& ranges)
+{
+    if (ranges.empty())
+        return;
+
+    vector<size_t> stored(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++)
+        stored[i] = locate(ranges[i].offset);
+
+    // bytes between two removed ranges move down in one piece
+    size_t write = stored[0];
+
+    for (size_t i = 0; i < stored.size(); i++)
+    {
+        size_t from = stored[i] + ranges[i].length;
+        size_t to = i + 1 < stored.size() ? stored[i + 1] : size;
+
+        memmove(data + write, data + from, to - from);
+        write += to - from;
+    }
+
+    size = write;
+
+    // runs are ascending as well, so one merge moves them all
+    size_t i = 0, removed = 0;
+
+    for (ZeroRun& run : runs)
+    {
+        for (; i < ranges.size() && ranges[i].offset < run.offset; i++)
+            removed += ranges[i].length;
+
+        run.offset -= removed;
+    }
+}
+
+size_t SectionBuffer::locate(size_t offset) const
+{
+    size_t low = 0, high = runs.size();
+
+    // first run which starts after the offset
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+
+        if (runs[middle].offset <= offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == 0)
+        return offset;
+
+    return offset - runs[low - 1].skipped - runs[low - 1].length;
+}
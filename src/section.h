@@ -0,0 +1,158 @@
+#ifndef SECTION_H
+#define SECTION_H
+
+#define SECTION_BUFFER_MINIMUM 256
+#define SECTION_ZERO_RUN_MINIMUM 64
+#define SECTION_READ_STEP (1 << 20)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+/*
+    Machine code of one section. Bytes are appended at the cursor and patched
+    in place by backpatching; the buffer grows geometrically, so appending is
+    a capacity check and a copy. Memory is taken with realloc, so capacity
+    reserved ahead is not touched until something is written into it.
+
+    Long runs of zeros (.skip) are not stored at all. Each run is recorded
+    with its offset in the section and the number of zeros left out before
+    it, so section offset of every stored byte is found by a binary search
+    over the runs.
+
+    When all section buffers together would keep more than the memory budget
+    on the heap, the growing buffer moves into an unlinked temporary file
+    mapped with MAP_SHARED. From then on it grows by extending the file, and
+    the kernel may write its pages back to the file instead of holding them
+    in memory. It grows by the budget, and every growth maps it again, so
+    pages written since the last growth are all it keeps mapped; writers read
+    it through read, which drops pages as they are written out.
+*/
+
+struct MemoryBudget
+{
+    size_t limit = 0; // 0 means no limit
+    size_t used = 0;
+};
+
+struct ZeroRun
+{
+    size_t offset;
+    size_t length;
+    size_t skipped; // zeros left out before this run
+};
+
+struct ByteRange
+{
+    size_t offset;
+    size_t length;
+};
+
+class SectionBuffer
+{
+public:
+
+    SectionBuffer() {}
+    ~SectionBuffer();
+
+    void setBudget(MemoryBudget* budget) { this->budget = budget; }
+
+    SectionBuffer(SectionBuffer&& other);
+    SectionBuffer& operator=(SectionBuffer&& other);
+
+    SectionBuffer(const SectionBuffer&) = delete;
+    SectionBuffer& operator=(const SectionBuffer&) = delete;
+
+    void reserve(size_t bytes);
+
+    void append(uint8_t byte)
+    {
+        if (size == capacity)
+            grow(1);
+        data[size++] = byte;
+    }
+
+    void append(const uint8_t* bytes, size_t count)
+    {
+        if (size + count > capacity)
+            grow(count);
+        memcpy(data + size, bytes, count);
+        size += count;
+    }
+
+    // room for count bytes at the cursor, written directly and taken with advance
+    uint8_t* claim(size_t count)
+    {
+        if (size + count > capacity)
+            grow(count);
+        return data + size;
+    }
+
+    void advance(size_t count) { size += count; }
+
+    void appendZeros(size_t count);
+
+    // offset is offset in the section, it never points into a zero run
+    void patchByte(size_t offset, uint8_t byte) { data[locate(offset)] = byte; }
+    void patchWord(size_t offset, uint16_t word)
+    {
+        size_t stored = locate(offset);
+        data[stored] = word & 0xFF;
+        data[stored + 1] = (word >> 8) & 0xFF;
+    }
+
+    uint8_t getByte(size_t offset) const { return data[locate(offset)]; }
+
+    // removes every range; ranges are ascending, disjoint and none touches a zero run
+    void remove(const vector<ByteRange>& ranges);
+
+    // stored bytes only, zero runs are left out
+    const uint8_t* getData() const { return data; }
+
+    // stored bytes [from, to) handed to consume in pieces; a spilled buffer hands out
+    // SECTION_READ_STEP bytes at a time and its pages leave memory once consumed, the file keeps them
+    template <typename Consumer>
+    void read(size_t from, size_t to, Consumer consume) const
+    {
+        size_t step = file >= 0 ? SECTION_READ_STEP : to - from;
+
+        while (from < to)
+        {
+            size_t count = to - from < step ? to - from : step;
+
+            consume(data + from, count);
+            evict(from, from + count);
+
+            from += count;
+        }
+    }
+    const vector<ZeroRun>& getZeroRuns() const { return runs; }
+
+    // size of the section, zero runs included
+    size_t getSize() const { return size + skipped; }
+    bool isEmpty() const { return getSize() == 0; }
+
+private:
+
+    void grow(size_t count);
+    void spill(size_t bytes);
+    void release();
+    void evict(size_t from, size_t to) const;
+    size_t locate(size_t offset) const;
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    vector<ZeroRun> runs;
+    size_t skipped = 0;
+
+    MemoryBudget* budget = nullptr;
+    int file = -1; // descriptor of the temporary file once the buffer spilled
+
+};
+
+#endif
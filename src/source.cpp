@@ -0,0 +1,83 @@
+#include "source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+
+SourceFile::~SourceFile()
+{
+    if (mapped)
+        munmap((void*)data, size);
+}
+
+void SourceFile::open(string path)
+{
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+        throw AssemblyException("Unable to open input file '" + path + "'.");
+
+    struct stat info;
+
+    if (fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        size = info.st_size;
+
+        if (size == 0)
+        {
+            ::close(descriptor);
+            return;
+        }
+
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+        if (mapping != MAP_FAILED)
+        {
+            madvise(mapping, size, MADV_SEQUENTIAL);
+
+            data = (const char*)mapping;
+            mapped = true;
+
+            ::close(descriptor);
+            return;
+        }
+    }
+
+    readWhole(descriptor, path);
+    ::close(descriptor);
+}
+
+void SourceFile::readWhole(int descriptor, string path)
+{
+    char chunk[1 << 16];
+    ssize_t count;
+
+    while ((count = ::read(descriptor, chunk, sizeof(chunk))) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + count);
+
+    if (count < 0)
+    {
+        ::close(descriptor);
+        throw AssemblyException("Unable to read input file '" + path + "'.");
+    }
+
+    data = buffer.data();
+    size = buffer.size();
+}
+
+void SourceFile::release(size_t offset)
+{
+    // given back in steps, not a system call per line
+    if (!mapped || offset < released + SOURCE_RELEASE_STEP)
+        return;
+
+    static const size_t page = sysconf(_SC_PAGESIZE);
+
+    offset -= offset % page;
+
+    madvise((void*)(data + released), offset - released, MADV_DONTNEED);
+    released = offset;
+}
@@ -0,0 +1,50 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#define SOURCE_RELEASE_STEP (1 << 20)
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/*
+    Input file is mapped into memory and never copied or rewritten; lines and
+    tokens handed to the assembler are views into the mapping. Files which can
+    not be mapped (pipes, character devices) are read into one buffer instead.
+
+    Pages of the mapping already read can be given back with release. They
+    hold the file's unchanged contents, so a view into them stays valid and
+    is only read from the file again if it is used.
+*/
+
+class SourceFile
+{
+public:
+
+    SourceFile() {}
+    ~SourceFile();
+
+    void open(string path);
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+
+    // whole pages before offset are dropped from memory, mapped files only and in steps of SOURCE_RELEASE_STEP
+    void release(size_t offset);
+
+private:
+
+    void readWhole(int descriptor, string path);
+
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    size_t released = 0;
+
+    vector<char> buffer;
+
+};
+
+#endif
@@ -1,90 +1,121 @@
 #include "structures.h"
 
-IdSymbol SymbolTable::insertSymbol(string name, unsigned long sectionNumber, unsigned long value, Scope Scope, bool defined)
+#include <algorithm>
+
+IdAtom StringPool::intern(string_view name)
 {
+    unordered_map<string_view, IdAtom>::iterator it = atoms.find(name);
 
-    map<IdSymbol, SymbolEntry>::iterator it;
+    if (it != atoms.end())
+        return it->second;
 
-    for (it = table.begin(); it != table.end(); it++)
-        if (it->second.name == name)
-            throw AssemblyException("Symbol '" + name + "' is already declared.");	
+    strings.push_back(string(name));
+    atoms.insert({ strings.back(), strings.size() - 1 });
 
+    return strings.size() - 1;
+}
 
-    SymbolEntry entry(cntr, name, sectionNumber, value, Scope, defined);
+IdAtom StringPool::find(string_view name) const
+{
+    unordered_map<string_view, IdAtom>::const_iterator it = atoms.find(name);
 
-    table.insert({ cntr, entry });
+    if (it != atoms.end())
+        return it->second;
 
-    return cntr++;
+    return ASM_UNDEFINED;
 }
 
-SymbolEntry* SymbolTable::getEntryByID(IdSymbol id)
+IdSymbol SymbolTable::insertSymbol(IdAtom name, unsigned long sectionNumber, unsigned long value, Scope Scope, bool defined)
 {
-    if (table.find(id) != table.end())
-        return &table.at(id);
-    else
-        return nullptr;
+    IdSymbol id = names.size();
+
+    if (!index.insert({ name, id }).second)
+        throw AssemblyException("Symbol '" + strings->getString(name) + "' is already declared.");	
+
+    names.push_back(name);
+    sections.push_back(sectionNumber);
+    values.push_back(value);
+    scopes.push_back((uint8_t)Scope);
+    flags.push_back(defined ? SYMBOL_DEFINED : 0);
+
+    return id;
 }
 
-SymbolEntry* SymbolTable::getEntryByName(string name)
+IdSymbol SymbolTable::getIdByName(string name) const
 {
-    map<IdSymbol, SymbolEntry>::iterator it;
+    IdAtom atom = strings->find(name);
 
-    for (it = table.begin(); it != table.end(); it++)
-        if (it->second.name == name)
-            return &it->second;
+    if (atom == (IdAtom)ASM_UNDEFINED)
+        return ASM_UNDEFINED;
 
-    return nullptr;
+    return getIdByName(atom);
 }
 
-stringstream SymbolTable::generateTextualSymbolTable()
+IdSymbol SymbolTable::getIdByName(IdAtom name) const
 {
-    stringstream output;
+    unordered_map<IdAtom, IdSymbol>::const_iterator it = index.find(name);
 
-    output << left;
-    output << setw(15) << "EntryNumber";
-    output << setw(15) << "Name";
-    output << setw(15) << "SectionNumber";
-    output << setw(15) << "Value";
-    output << setw(15) << "Scope";
-    output << endl;
+    if (it != index.end())
+        return it->second;
 
-    map<IdSymbol, SymbolEntry>::iterator it;
+    return ASM_UNDEFINED;
+}
 
-    for (it = table.begin(); it != table.end(); it++)
+SymbolEntry SymbolTable::getEntryByID(IdSymbol id) const
+{
+    return SymbolEntry(id, names[id], sections[id], values[id], getScope(id), isDefined(id));
+}
+
+void SymbolTable::deleteSymbol(const IdSymbol& id)
+{
+    if (!exists(id))
+        return;
+
+    index.erase(names[id]);
+    flags[id] |= SYMBOL_DELETED;
+    deleted++;
+}
+
+void SymbolTable::generateTextualSymbolTable(TextWriter& writer)
+{
+    writer.column("EntryNumber");
+    writer.column("Name");
+    writer.column("SectionNumber");
+    writer.column("Value");
+    writer.column("Scope");
+    writer.character('\n');
+
+    for (IdSymbol id = 0; id < names.size(); id++)
     {
-        output << left;
+        if (flags[id] & SYMBOL_DELETED)
+            continue;
 
-        output << setw(15) << hex << it->second.entryNo;
+        writer.column(id);
 
-        output << setw(15) << it->second.name;
+        writer.column(strings->getString(names[id]));
 
-        if (it->second.section != ASM_UNDEFINED)
-            output << setw(15) << hex << it->second.section;
+        if (sections[id] != ASM_UNDEFINED)
+            writer.column(sections[id]);
         else
-            output << setw(15) << "N/A";
+            writer.column("N/A");
 
-        output << setw(15) << hex << it->second.value;
+        writer.column(values[id]);
 
-        if (it->second.scope == Scope::GLOBAL)
-            output << setw(15) << "GLOBAL";
-        else if (it->second.scope == Scope::EXTERN)
-            output << setw(15) << "EXTERN";
+        if (scopes[id] == Scope::GLOBAL)
+            writer.column("GLOBAL");
+        else if (scopes[id] == Scope::EXTERN)
+            writer.column("EXTERN");
         else
-            output << setw(15) << "LOCAL";
+            writer.column("LOCAL");
 
-        output << endl;
+        writer.character('\n');
     }
-
-    return output;
 }
 
-IdSection SectionTable::insertSection(string name, unsigned long length, unsigned long lineNumber)
+IdSection SectionTable::insertSection(IdAtom name, unsigned long length, unsigned long lineNumber)
 {
-    map<IdSection, SectionEntry>::iterator it;
-
-    for (it = table.begin(); it != table.end(); it++)
-        if (it->second.name == name)
-            throw AssemblyException("Section '" + name + "' is already declared.");	
+    if (!index.insert({ name, cntr }).second)
+        throw AssemblyException("Section '" + strings->getString(name) + "' is already declared.");	
 
     
     SectionEntry entry(cntr, name, length);
@@ -101,87 +132,114 @@ SectionEntry* SectionTable::getEntryByID(IdSection id)
         return nullptr;
 }
 
-SectionEntry* SectionTable::getEntryByName(string name)
+SectionEntry* SectionTable::getEntryByName(IdAtom name)
 {
-    map<IdSection, SectionEntry>::iterator it;
+    unordered_map<IdAtom, IdSection>::iterator it = index.find(name);
 
-    for (it = table.begin(); it != table.end(); it++)
-        if (it->second.name == name)
-            return &it->second;
+    if (it != index.end())
+        return &table.at(it->second);
 
     return nullptr;
 }
 
-stringstream SectionTable::generateTextualSectionTable()
+void SectionTable::generateTextualSectionTable(TextWriter& writer, bool withAddresses)
 {
-    stringstream output;
-
-    output << left;
-    output << setw(15) << "EntryNumber";
-    output << setw(15) << "Name";
-    output << setw(15) << "Length";
-    output << setw(15) << "SymbolEntryNumber";
-    output << endl;
+    writer.column("EntryNumber");
+    writer.column("Name");
+    writer.column("Length");
+    writer.column("SymbolEntryNumber");
+    if (withAddresses) // header above is two characters wider than its column
+    {
+        writer.text("  ");
+        writer.column("Address");
+    }
+    writer.character('\n');
 
     map<IdSection, SectionEntry>::iterator it;
 
     for (it = table.begin(); it != table.end(); it++)
     {
-        output << left;
-        output << setw(15) << hex << it->second.entryNo;
-        output << setw(15) << it->second.name;
-        output << setw(15) << hex << it->second.length;
-        output << setw(15) << hex << it->second.SymbolEntryNo;
-        output << endl;
+        writer.column(it->second.entryNo);
+        writer.column(strings->getString(it->second.name));
+        writer.column(it->second.length);
+        writer.column(it->second.SymbolEntryNo);
+        if (withAddresses && it->second.address != ASM_UNDEFINED)
+        {
+            writer.text("    ");
+            writer.column(it->second.address);
+        }
+        writer.character('\n');
     }
-
-    return output;
-
 }
 
 void RelocationTable::insertRelocation(unsigned long section, unsigned long offset, RelocationType relocationType, unsigned long value)
 {
+    if (section >= sections.size())
+        sections.resize(section + 1);
+
+    vector<RelocationEntry>& relocations = sections[section];
     RelocationEntry entry(section, offset, relocationType, value);
-    table.push_back(entry);
+
+    if (relocations.empty() || relocations.back().offset <= offset)
+        relocations.push_back(entry);
+    else
+        relocations.insert(
+            upper_bound(relocations.begin(), relocations.end(), offset, [](unsigned long offset, const RelocationEntry& entry) {
+                return offset < entry.offset;
+            }),
+            entry
+        );
+
+    size++;
 }
 
-stringstream RelocationTable::generateTextualRelocationTable(IdSection idSection)
+const vector<RelocationEntry>& RelocationTable::getRelocations(IdSection idSection) const
 {
-    stringstream output;
+    static const vector<RelocationEntry> none;
 
-    output << left;
-    output << setw(15) << "Offset";
-    output << setw(15) << "RelocationType";
-    output << setw(15) << "Value";
-    output << endl;
+    if (idSection >= sections.size())
+        return none;
 
-    vector<RelocationEntry>::iterator it;
+    return sections[idSection];
+}
 
-    for (it = table.begin(); it != table.end(); it++)
-    {
-        if (it->section == idSection) {
-            output << left;
-            output << setw(15) << hex << it->offset;
-            output << setw(15) << (it->relocationType == RelocationType::R_386_PC16 ? "R_386_PC16" : "R_386_16");
-            output << setw(15) << hex << it->value;
-            output << endl;
-        }
-    }
+pair<const RelocationEntry*, const RelocationEntry*> RelocationTable::getRange(IdSection idSection, unsigned long begin, unsigned long end) const
+{
+    const vector<RelocationEntry>& relocations = getRelocations(idSection);
 
-    return output;
+    auto byOffset = [](const RelocationEntry& entry, unsigned long offset) {
+        return entry.offset < offset;
+    };
+
+    const RelocationEntry* first = relocations.data() + (lower_bound(relocations.begin(), relocations.end(), begin, byOffset) - relocations.begin());
+    const RelocationEntry* last = relocations.data() + (lower_bound(relocations.begin(), relocations.end(), end, byOffset) - relocations.begin());
+
+    return { first, last };
 }
 
-void TNSTable::insertSymbol(IdSection section, string name,string expression, Scope scope)
+void RelocationTable::generateTextualRelocationTable(TextWriter& writer, IdSection idSection)
 {
-    vector<TNSEntry>::iterator it;
+    writer.column("Offset");
+    writer.column("RelocationType");
+    writer.column("Value");
+    writer.character('\n');
 
-    TNSEntry entry(section, name, expression, scope);
+    for (const RelocationEntry& entry : getRelocations(idSection))
+    {
+        writer.column(entry.offset);
+        writer.column(entry.relocationType == RelocationType::R_386_PC16 ? "R_386_PC16" : "R_386_16");
+        writer.column(entry.value);
+        writer.character('\n');
+    }
+}
 
-    for (it = table.begin(); it != table.end(); it++)
-        if (it->name == name)
-            throw AssemblyException("TNS symbol '" + name + "' is already declared.");	
+void TNSTable::insertSymbol(IdSection section, IdAtom name, Expression expression, Scope scope)
+{
+    if (index.find(name) != index.end())
+        throw AssemblyException("TNS symbol '" + strings->getString(name) + "' is already declared.");	
 
-    table.push_back(entry);
+    index.insert({name, table.size()});
+    table.push_back(TNSEntry(section, name, move(expression), scope));
 }
 
 TNSEntry* TNSTable::getEntryByID(unsigned id)
@@ -189,20 +247,45 @@ TNSEntry* TNSTable::getEntryByID(unsigned id)
     return &table.at(id);
 }
 
-TNSEntry* TNSTable::getEntryByName(string name)
+TNSEntry* TNSTable::getEntryByName(IdAtom name)
 {
-    for (size_t i = 0; i < table.size(); i++)
-        if (table.at(i).name == name)
-            return &table.at(i);
+    unsigned long id = getIdByName(name);
 
-    return nullptr;
+    if (id == ASM_UNDEFINED)
+        return nullptr;
+
+    return &table.at(id);
 }
 
-void TNSTable::deleteEntryByName(string name)
+unsigned long TNSTable::getIdByName(IdAtom name) const
 {
-    for (size_t i = 0; i < table.size(); i++)
-        if (table.at(i).name == name)
-            table.erase(table.begin() + i);
+    unordered_map<IdAtom, unsigned long>::const_iterator it = index.find(name);
+
+    if (it == index.end())
+        return ASM_UNDEFINED;
+
+    return it->second;
+}
+
+void TNSTable::deleteEntryByName(IdAtom name)
+{
+    unsigned long id = getIdByName(name);
+
+    if (id == ASM_UNDEFINED)
+        return;
+
+    table.erase(table.begin() + id);
+    index.erase(name);
+
+    // entries after the erased one moved one place down
+    for (unsigned long i = id; i < table.size(); i++)
+        index[table.at(i).name] = i;
+}
+
+void TNSTable::clear()
+{
+    table.clear();
+    index.clear();
 }
 
 /*
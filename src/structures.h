@@ -1,32 +1,64 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
 
+#include <deque>
 #include <iomanip>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "enums.h"
 #include "exceptions.h"
+#include "textwriter.h"
 #include "token.h"
 
 using namespace std;
 
+/*
+    Every symbol and section name is stored once in the pool; tables, TNS
+    entries and backpatch records keep only its atom, so names are compared
+    as integers and a symbol referenced many times costs one string.
+*/
+
+class StringPool
+{
+public:
+
+    IdAtom intern(string_view name);
+    IdAtom find(string_view name) const;
+
+    const string& getString(IdAtom atom) const { return strings[atom]; }
+    size_t getSize() const { return strings.size(); }
+
+private:
+
+    deque<string> strings;
+    unordered_map<string_view, IdAtom> atoms;
+
+};
+
 struct SymbolElement {
-    string symbol;
+    IdAtom symbol;
     struct SymbolElement* next;
-    SymbolElement(string symbol, SymbolElement* next) : symbol(symbol), next(next) {}
+    SymbolElement(IdAtom symbol, SymbolElement* next) : symbol(symbol), next(next) {}
 };
 
 struct SymbolReference {
 
-    string symbol;
+    IdAtom symbol;
     IdSection inSection;
     unsigned long patch;
     RelocationType relocationType;
     unsigned long nextInstructionLC;
     bool modifyOneByte;
+    bool removed = false; // displacement or whole instruction was dropped, nothing left to patch
     SymbolReference *next = nullptr;
 
     SymbolReference(
-        string symbol, 
+        IdAtom symbol, 
         IdSection inSection, 
         unsigned long patch,
         RelocationType relocationType,
@@ -42,10 +74,15 @@ struct SymbolReference {
 
 };
 
+// references to one symbol that are not patched yet, in order they were made
+struct SymbolFixups {
+    SymbolReference *first = nullptr, *last = nullptr;
+};
+
 struct SymbolEntry
 {
     IdSymbol entryNo;
-    string name;
+    IdAtom name;
     IdSection section;		
     unsigned long value;
     Scope scope;
@@ -53,7 +90,7 @@ struct SymbolEntry
 
     SymbolEntry(
         IdSymbol entryNo, 
-        string name, 
+        IdAtom name, 
         unsigned long section, 
         unsigned long value, 
         Scope scope, 
@@ -66,36 +103,75 @@ struct SymbolEntry
     {}
 };
 
+/*
+    Symbols are stored densely by ID, one array per field, so ID lookup is an
+    index and scans over the table read only the fields they need. Deleted
+    symbols are only marked, IDs of the remaining symbols never change.
+*/
+
+#define SYMBOL_DEFINED 1
+#define SYMBOL_DELETED 2
+#define SYMBOL_LABEL 4      // value is an offset in its section, moves when code before it shrinks
+
 class SymbolTable
 {
 public:
 
-    IdSymbol insertSymbol(string name, unsigned long section, unsigned long value, Scope Scope, bool defined);
+    SymbolTable(StringPool* strings) : strings(strings) {}
 
-    SymbolEntry* getEntryByID(IdSymbol id);
-    SymbolEntry* getEntryByName(string name);
+    IdSymbol insertSymbol(IdAtom name, unsigned long section, unsigned long value, Scope Scope, bool defined);
 
-    stringstream generateTextualSymbolTable();
-    size_t getSize() { return table.size(); }
+    IdSymbol getIdByName(IdAtom name) const;
+    IdSymbol getIdByName(string name) const;
+
+    bool exists(IdSymbol id) const { return id < names.size() && !(flags[id] & SYMBOL_DELETED); }
+
+    IdAtom getName(IdSymbol id) const { return names[id]; }
+    IdSection getSection(IdSymbol id) const { return sections[id]; }
+    unsigned long getValue(IdSymbol id) const { return values[id]; }
+    Scope getScope(IdSymbol id) const { return (Scope)scopes[id]; }
+    bool isDefined(IdSymbol id) const { return flags[id] & SYMBOL_DEFINED; }
+    bool isLabel(IdSymbol id) const { return flags[id] & SYMBOL_LABEL; }
+
+    void define(IdSymbol id, unsigned long value) { values[id] = value; flags[id] |= SYMBOL_DEFINED; }
+    void setScope(IdSymbol id, Scope scope) { scopes[id] = (uint8_t)scope; }
+    void markLabel(IdSymbol id) { flags[id] |= SYMBOL_LABEL; }
+
+    SymbolEntry getEntryByID(IdSymbol id) const;
+
+    // IDs are below this bound, deleted ones included
+    IdSymbol getIdBound() const { return names.size(); }
 
-    void deleteSymbol(const IdSymbol& id) { table.erase(id); }
+    void generateTextualSymbolTable(TextWriter& writer);
+    size_t getSize() { return names.size() - deleted; }
+
+    void deleteSymbol(const IdSymbol& id);
 
 private:
 
-    map<IdSymbol, SymbolEntry> table;
-    unsigned long cntr = 0;
+    vector<IdAtom> names;
+    vector<IdSection> sections;
+    vector<unsigned long> values;
+    vector<uint8_t> scopes;
+    vector<uint8_t> flags;
+    size_t deleted = 0;
+
+    unordered_map<IdAtom, IdSymbol> index;
+
+    StringPool* strings;
 
 };
 
 struct SectionEntry
 {
     IdSection entryNo;
-    string name;
+    IdAtom name;
     unsigned long length;
     IdSymbol SymbolEntryNo = -1;
+    unsigned long address = ASM_UNDEFINED; // load address in absolute mode
 
     SectionEntry() {}
-    SectionEntry(IdSection entryNo, string name, unsigned long length) :
+    SectionEntry(IdSection entryNo, IdAtom name, unsigned long length) :
         name(name), length(length), entryNo(entryNo) {}
 };
 
@@ -103,12 +179,14 @@ class SectionTable
 {
 public:
 
-    IdSection insertSection(string name, unsigned long length, unsigned long lineNumber);
+    SectionTable(StringPool* strings) : strings(strings) {}
+
+    IdSection insertSection(IdAtom name, unsigned long length, unsigned long lineNumber);
 
     SectionEntry* getEntryByID(IdSection id);
-    SectionEntry* getEntryByName(string name);
+    SectionEntry* getEntryByName(IdAtom name);
 
-    stringstream generateTextualSectionTable();
+    void generateTextualSectionTable(TextWriter& writer, bool withAddresses = false);
 
     size_t GetSize() { return table.size(); }
 
@@ -117,8 +195,11 @@ public:
 private:
 
     map<IdSection, SectionEntry> table;
+    unordered_map<IdAtom, IdSection> index;
     IdSection cntr = 0;
 
+    StringPool* strings;
+
 };
 
 struct RelocationEntry
@@ -140,49 +221,87 @@ struct RelocationEntry
     {}
 };
 
+/*
+    Relocations are kept per section, sorted by offset. Backpatching inserts
+    them in offset order already, so insertion is normally an append; any
+    other order falls back to inserting at the right place.
+*/
+
 class RelocationTable
 {
 public:
 
     void insertRelocation(unsigned long section, unsigned long offset, RelocationType relocationType, unsigned long value);
 
-    RelocationEntry* getEntryByID(int id) { return &table.at(id); }
+    const vector<RelocationEntry>& getRelocations(IdSection idSection) const;
+
+    // relocations of the section with offset in [begin, end)
+    pair<const RelocationEntry*, const RelocationEntry*> getRange(IdSection idSection, unsigned long begin, unsigned long end) const;
 
-    stringstream generateTextualRelocationTable(IdSection idSection);
+    void generateTextualRelocationTable(TextWriter& writer, IdSection idSection);
     
-    size_t getSize() { return table.size(); }
+    size_t getSize() { return size; }
 
     friend class Assembler;
 
 private:
 
-    vector<RelocationEntry> table;
-    IdSection cntr = 0;
+    // indexed by section ID
+    vector<vector<RelocationEntry>> sections;
+    size_t size = 0;
+
+};
+
+/*
+    Expression of .equ directive is compiled once, when the directive is read.
+    Only + and - exist and both are left associative, so the expression is
+    kept as a flat list of signed terms and evaluated with one accumulator.
+*/
+
+enum ExpressionTermType : uint8_t
+{
+    TERM_CONSTANT,
+    TERM_SYMBOL
+};
 
+struct ExpressionTerm
+{
+    ExpressionTermType type;
+    bool negative;
+    unsigned long value; // constant or name atom of the symbol
+
+    ExpressionTerm(ExpressionTermType type, bool negative, unsigned long value) :
+        type(type), negative(negative), value(value) {}
 };
 
+typedef vector<ExpressionTerm> Expression;
+
 struct TNSEntry
 {
     IdSection section;
-    string name;
-    string expression;
+    IdAtom name;
+    Expression expression;
     Scope scope;
 
     TNSEntry() {}
-    TNSEntry(IdSection section, string name, string expression, Scope Scope) :
-        name(name), section(section), expression(expression), scope(Scope) {}
+    TNSEntry(IdSection section, IdAtom name, Expression expression, Scope Scope) :
+        section(section), name(name), expression(move(expression)), scope(Scope) {}
 };
 
 class TNSTable
 {
 public:
 
-    void insertSymbol(IdSection section, string name, string expression, Scope scope);
+    TNSTable(StringPool* strings) : strings(strings) {}
+
+    void insertSymbol(IdSection section, IdAtom name, Expression expression, Scope scope);
 
     TNSEntry* getEntryByID(unsigned id);
-    TNSEntry* getEntryByName(string name);
+    TNSEntry* getEntryByName(IdAtom name);
+    unsigned long getIdByName(IdAtom name) const;
 
-    void deleteEntryByName(string name);
+    void deleteEntryByName(IdAtom name);
+    void clear();
     /*stringstream generateTextualTNSTable();*/
 
     size_t getSize() { return table.size(); }
@@ -191,6 +310,9 @@ public:
 private:
 
     vector<TNSEntry> table;
+    unordered_map<IdAtom, unsigned long> index;
+
+    StringPool* strings;
 
 };
 
@@ -0,0 +1,60 @@
+#include "textwriter.h"
+
+static const char spaces[TEXT_COLUMN_WIDTH + 1] = "               ";
+
+void TextWriter::column(const char* data, size_t size)
+{
+    text(data, size);
+
+    if (size < TEXT_COLUMN_WIDTH)
+        text(spaces, TEXT_COLUMN_WIDTH - size);
+}
+
+void TextWriter::column(unsigned long value)
+{
+    char digits[2 * sizeof(unsigned long)];
+    size_t size = formatHex(value, digits);
+
+    column(digits + sizeof(digits) - size, size);
+}
+
+void TextWriter::hex(unsigned long value)
+{
+    char digits[2 * sizeof(unsigned long)];
+    size_t size = formatHex(value, digits);
+
+    text(digits + sizeof(digits) - size, size);
+}
+
+// digits are written to the end of the array, returns their count
+size_t TextWriter::formatHex(unsigned long value, char* digits)
+{
+    size_t size = 0;
+    char* last = digits + 2 * sizeof(unsigned long);
+
+    do
+    {
+        *--last = hexDigits.digits[value & 0xF][1];
+        value >>= 4;
+        size++;
+    } while (value);
+
+    return size;
+}
+
+void TextWriter::makeRoom(size_t size)
+{
+    flush();
+
+    if (size > buffer.size())
+        buffer.resize(size);
+}
+
+void TextWriter::flush()
+{
+    if (used == 0)
+        return;
+
+    output.write(buffer.data(), used);
+    used = 0;
+}
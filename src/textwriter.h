@@ -0,0 +1,91 @@
+#ifndef TEXTWRITER_H
+#define TEXTWRITER_H
+
+#define TEXT_COLUMN_WIDTH 15
+#define TEXT_WRITER_BUFFER (1 << 20)
+
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+    Text dump is formatted into one reusable buffer which is handed to the
+    stream in large blocks. Bytes go through a 256 entry table of their two
+    hex digits, numbers are formatted by hand and columns are padded from a
+    line of spaces, so no stream formatting is involved.
+*/
+
+struct HexDigits
+{
+    char digits[256][2];
+
+    constexpr HexDigits() : digits()
+    {
+        const char* hex = "0123456789abcdef";
+
+        for (int i = 0; i < 256; i++)
+        {
+            digits[i][0] = hex[i >> 4];
+            digits[i][1] = hex[i & 0xF];
+        }
+    }
+};
+
+class TextWriter
+{
+public:
+
+    TextWriter(ostream& output) : output(output), buffer(TEXT_WRITER_BUFFER) {}
+    ~TextWriter() { flush(); }
+
+    void text(const char* data, size_t size)
+    {
+        if (used + size > buffer.size())
+            makeRoom(size);
+        memcpy(&buffer[used], data, size);
+        used += size;
+    }
+
+    void text(const string& data) { text(data.data(), data.size()); }
+    void text(const char* data) { text(data, strlen(data)); }
+    void character(char c) { text(&c, 1); }
+
+    // left aligned in a column, like setw(TEXT_COLUMN_WIDTH) << left
+    void column(const string& data) { column(data.data(), data.size()); }
+    void column(const char* data) { column(data, strlen(data)); }
+    void column(const char* data, size_t size);
+    void column(unsigned long value);
+
+    void hex(unsigned long value);
+
+    // two hex digits followed by separator
+    void byte(uint8_t value, char separator)
+    {
+        if (used + 3 > buffer.size())
+            makeRoom(3);
+        buffer[used++] = hexDigits.digits[value][0];
+        buffer[used++] = hexDigits.digits[value][1];
+        buffer[used++] = separator;
+    }
+
+    void flush();
+
+private:
+
+    void makeRoom(size_t size);
+    size_t formatHex(unsigned long value, char* digits);
+
+    static constexpr HexDigits hexDigits = HexDigits();
+
+    ostream& output;
+    vector<char> buffer;
+    size_t used = 0;
+
+};
+
+#endif
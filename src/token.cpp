@@ -1,185 +1,488 @@
 #include "token.h"
 
-#include <string.h>
-#include <assert.h> 
-
 #include "exceptions.h"
+#include "mnemonics.h"
+#include "structures.h"
+
+struct CharacterClasses
+{
+    CharacterClass table[256];
+
+    constexpr CharacterClasses() : table()
+    {
+        for (int c = 'a'; c <= 'z'; c++)
+        {
+            table[c] = CharacterClass::CLASS_LETTER;
+            table[c - 'a' + 'A'] = CharacterClass::CLASS_LETTER;
+        }
+
+        for (int c = 'a'; c <= 'f'; c++)
+        {
+            table[c] = CharacterClass::CLASS_HEX_LETTER;
+            table[c - 'a' + 'A'] = CharacterClass::CLASS_HEX_LETTER;
+        }
+
+        for (int c = '1'; c <= '9'; c++)
+            table[c] = CharacterClass::CLASS_DIGIT;
+
+        table['x'] = table['X'] = CharacterClass::CLASS_X;
+        table['0'] = CharacterClass::CLASS_ZERO;
+        table['_'] = CharacterClass::CLASS_UNDERSCORE;
+        table['.'] = CharacterClass::CLASS_DOT;
+        table[':'] = CharacterClass::CLASS_COLON;
+        table['+'] = table['-'] = CharacterClass::CLASS_SIGN;
+        table['%'] = CharacterClass::CLASS_PERCENT;
+        table['('] = CharacterClass::CLASS_LEFT_PARENTHESIS;
+        table[')'] = CharacterClass::CLASS_RIGHT_PARENTHESIS;
+    }
+};
+
+struct Transitions
+{
+    LexerState table[NUMBER_OF_STATES][NUMBER_OF_CLASSES];
+
+    constexpr void letters(LexerState from, LexerState to)
+    {
+        table[from][CLASS_LETTER] = table[from][CLASS_HEX_LETTER] = table[from][CLASS_X] = to;
+    }
+
+    constexpr void digits(LexerState from, LexerState to)
+    {
+        table[from][CLASS_ZERO] = table[from][CLASS_DIGIT] = to;
+    }
+
+    constexpr Transitions() : table()
+    {
+        // .global, .section, .word ...
+        table[STATE_START][CLASS_DOT] = STATE_DOT;
+        letters(STATE_DOT, STATE_DOT_WORD);
+        letters(STATE_DOT_WORD, STATE_DOT_WORD);
+
+        // symbol, mnemonic, label: and symbol(%rX)
+        letters(STATE_START, STATE_IDENTIFIER);
+        letters(STATE_IDENTIFIER, STATE_IDENTIFIER);
+        digits(STATE_IDENTIFIER, STATE_IDENTIFIER);
+        table[STATE_IDENTIFIER][CLASS_UNDERSCORE] = STATE_IDENTIFIER;
+        table[STATE_IDENTIFIER][CLASS_COLON] = STATE_LABEL;
+        table[STATE_IDENTIFIER][CLASS_LEFT_PARENTHESIS] = STATE_PARENTHESIS;
+
+        // arithmetic operator and signed decimal literal
+        table[STATE_START][CLASS_SIGN] = STATE_SIGN;
+        digits(STATE_SIGN, STATE_DECIMAL);
+
+        // decimal and hexadecimal literal, optionally followed by (%rX)
+        table[STATE_START][CLASS_ZERO] = STATE_ZERO;
+        table[STATE_START][CLASS_DIGIT] = STATE_DECIMAL;
+        digits(STATE_ZERO, STATE_DECIMAL);
+        table[STATE_ZERO][CLASS_X] = STATE_HEX_PREFIX;
+        table[STATE_ZERO][CLASS_LEFT_PARENTHESIS] = STATE_PARENTHESIS;
+        digits(STATE_DECIMAL, STATE_DECIMAL);
+        table[STATE_DECIMAL][CLASS_LEFT_PARENTHESIS] = STATE_PARENTHESIS;
+        digits(STATE_HEX_PREFIX, STATE_HEXADECIMAL);
+        table[STATE_HEX_PREFIX][CLASS_HEX_LETTER] = STATE_HEXADECIMAL;
+        digits(STATE_HEXADECIMAL, STATE_HEXADECIMAL);
+        table[STATE_HEXADECIMAL][CLASS_HEX_LETTER] = STATE_HEXADECIMAL;
+        table[STATE_HEXADECIMAL][CLASS_LEFT_PARENTHESIS] = STATE_PARENTHESIS;
+
+        // %rX
+        table[STATE_START][CLASS_PERCENT] = STATE_PERCENT;
+        letters(STATE_PERCENT, STATE_REGISTER);
+        letters(STATE_REGISTER, STATE_REGISTER);
+        digits(STATE_REGISTER, STATE_REGISTER);
+
+        // (%rX)
+        table[STATE_START][CLASS_LEFT_PARENTHESIS] = STATE_PARENTHESIS;
+        table[STATE_PARENTHESIS][CLASS_PERCENT] = STATE_PARENTHESIS_PERCENT;
+        letters(STATE_PARENTHESIS_PERCENT, STATE_PARENTHESIS_REGISTER);
+        letters(STATE_PARENTHESIS_REGISTER, STATE_PARENTHESIS_REGISTER);
+        digits(STATE_PARENTHESIS_REGISTER, STATE_PARENTHESIS_REGISTER);
+        table[STATE_PARENTHESIS_REGISTER][CLASS_RIGHT_PARENTHESIS] = STATE_PARENTHESIS_CLOSED;
+    }
+};
+
+static constexpr CharacterClasses characterClasses;
+
+static const char* const registerNames[8] = { "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7" };
+static constexpr Transitions transitions;
+
+static char toLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static bool equalsIgnoreCase(string_view data, size_t begin, size_t end, const char* word)
+{
+    size_t i = begin;
+
+    for (; i < end && *word; i++, word++)
+        if (toLower(data[i]) != *word)
+            return false;
+
+    return i == end && *word == '\0';
+}
 
 TokenType Token::getType() const {
     return type;
 }
 
-string Token::getValue() const {
+const string& Token::getValue() const {
     return value;
 }
 
-Token Token::parse(string str, unsigned long line, bool recursive = true) {
+LexerState Token::scan(string_view data, size_t& parenthesis)
+{
+    LexerState state = LexerState::STATE_START;
 
-    if (str.size() == 0)
-        return Token(TokenType::INVALID, 0);
-
-    string data = str;
+    parenthesis = string::npos;
 
-    data = regex_replace(data, regex("%sp"), "%r6");
-    data = regex_replace(data, regex("%pc"), "%r7");
-    data = regex_replace(data, regex("%psw"), "%r15");
+    for (size_t i = 0; i < data.size() && state != LexerState::STATE_REJECT; i++)
+    {
+        CharacterClass c = characterClasses.table[(uint8_t)data[i]];
 
-    bool isImmediate = false;
-    bool isAsterisk = false;
+        if (c == CharacterClass::CLASS_LEFT_PARENTHESIS && parenthesis == string::npos)
+            parenthesis = i;
 
-    if (data.at(0) == '*')
-    {
-        data = data.substr(1, data.size() - 1);
-        isAsterisk = true;
+        state = transitions.table[state][c];
     }
-    else if (data.at(0) == '$')
+
+    return state;
+}
+
+bool Token::parseRegister(string_view data, size_t begin, size_t end, const char*& canonical, char& half)
+{
+    // aliases %sp, %pc and %psw are replaced with %r6, %r7 and %r15
+    half = 0;
+
+    if (end - begin > 2 && (toLower(data[end - 1]) == 'h' || toLower(data[end - 1]) == 'l'))
     {
-        data = data.substr(1, data.size() - 1);
-        isImmediate = true;
+        half = toLower(data[end - 1]);
+        end--;
     }
 
-    int i = 0;
-    TokenType r1;
-    string r2;
+    if (equalsIgnoreCase(data, begin, end, "sp"))
+        canonical = registerNames[6];
+    else if (equalsIgnoreCase(data, begin, end, "pc"))
+        canonical = registerNames[7];
+    else if (equalsIgnoreCase(data, begin, end, "psw"))
+        canonical = "r15";
+    else if (equalsIgnoreCase(data, begin, end, "r15"))
+        canonical = "r15";
+    else if (end - begin == 2 && toLower(data[begin]) == 'r' && data[begin + 1] >= '0' && data[begin + 1] <= '7')
+        canonical = registerNames[data[begin + 1] - '0'];
+    else
+        return false;
+
+    return true;
+}
 
-    while (i < NUMBER_OF_PARSERS) {
+bool Token::isMnemonic(string_view data)
+{
+    return Mnemonics::find(data.data(), data.size()) != nullptr;
+}
 
-        if (regex_match(data, parsers[i])) {
-        
-            switch (i) {
+bool Token::isArithmeticOperand(TokenType type)
+{
+    return
+        type == TokenType::IMMEDIATE_DECIMAL ||
+        type == TokenType::DECIMAL ||
+        type == TokenType::IMMEDIATE_HEXADECIMAL ||
+        type == TokenType::HEXADECIMAL ||
+        type == TokenType::IMMEDIATE_SYMBOL ||
+        type == TokenType::SYMBOL;
+}
 
-                // access modifier
-                case 0: 
-                    r1 = TokenType::ACCESS_MODIFIER;
-                    r2 = data;
-                break;
+TokenType Token::classify(string_view data, LexerState state, size_t parenthesis, string& value, bool isAsterisk, bool isImmediate)
+{
+    const char* canonical;
+    char half;
 
-                // label; remove ":" at the end
-                case 1:
-                    r1 = TokenType::LABEL;
-                    r2 = data.substr(0, data.length() - 1);
-                break;
+    // value reuses storage of the token, see lex
+    value.assign(data.data(), data.size());
 
-                // section
-                case 2:
-                    r1 = TokenType::SECTION;
-                    r2 = data;
-                break;
+    switch (state) {
 
-                // directive
-                case 3:
-                    r1 = TokenType::DIRECTIVE;
-                    r2 = data;
-                break;
+        // .global, .extern, .section, .byte, .equ, .skip, .word, .end
+        case LexerState::STATE_DOT_WORD:
+        {
+            size_t size = data.size();
 
-                // instruction
-                case 4:
-                    r1 = TokenType::INSTRUCTION;
-                    r2 = data;
-                break;
+            if (equalsIgnoreCase(data, 0, size, ".global") || equalsIgnoreCase(data, 0, size, ".extern"))
+                return TokenType::ACCESS_MODIFIER;
 
-                // end of file
-                case 5:
-                    r1 = TokenType::END_OF_SECTIONS;
-                    r2 = data;
-                break;
+            if (equalsIgnoreCase(data, 0, size, ".section"))
+                return TokenType::SECTION;
 
-                // arithmetic operator
-                case 6:
-                    r1 = TokenType::ARITHMETIC_OPERATOR;
-                    r2 = data;
-                break;
+            if (
+                equalsIgnoreCase(data, 0, size, ".byte") ||
+                equalsIgnoreCase(data, 0, size, ".equ") ||
+                equalsIgnoreCase(data, 0, size, ".skip") ||
+                equalsIgnoreCase(data, 0, size, ".word")
+            )
+                return TokenType::DIRECTIVE;
 
-                // symbol
-                case 7:
-                    if (isAsterisk)
-                        r1 = TokenType::ASTERISK_SYMBOL;
-                    else if (isImmediate)
-                        r1 = TokenType::IMMEDIATE_SYMBOL;
-                    else
-                        r1 = TokenType::SYMBOL;
-                    r2 = data;
+            if (equalsIgnoreCase(data, 0, size, ".end"))
+                return TokenType::END_OF_SECTIONS;
+        }
+        break;
+
+        // label; remove ":" at the end
+        case LexerState::STATE_LABEL:
+            value.pop_back();
+            return TokenType::LABEL;
+
+        // instruction or symbol
+        case LexerState::STATE_IDENTIFIER:
+            if (isMnemonic(data))
+                return TokenType::INSTRUCTION;
+
+            if (isAsterisk)
+                return TokenType::ASTERISK_SYMBOL;
+            else if (isImmediate)
+                return TokenType::IMMEDIATE_SYMBOL;
+            else
+                return TokenType::SYMBOL;
+
+        // arithmetic operator
+        case LexerState::STATE_SIGN:
+            return TokenType::ARITHMETIC_OPERATOR;
+
+        // literal decimal
+        case LexerState::STATE_ZERO:
+        case LexerState::STATE_DECIMAL:
+            if (isAsterisk)
+                return TokenType::ASTERISK_DECIMAL;
+            else if (isImmediate)
+                return TokenType::IMMEDIATE_DECIMAL;
+            else
+                return TokenType::DECIMAL;
+
+        // literal hexadecimal
+        case LexerState::STATE_HEXADECIMAL:
+            if (isAsterisk)
+                return TokenType::ASTERISK_HEXADECIMAL;
+            else if (isImmediate)
+                return TokenType::IMMEDIATE_HEXADECIMAL;
+            else
+                return TokenType::HEXADECIMAL;
+
+        // register direct
+        case LexerState::STATE_REGISTER:
+            if (!parseRegister(data, 1, data.size(), canonical, half))
                 break;
 
-                // literal decimal
-                case 8:
-                    if (isAsterisk)
-                        r1 = TokenType::ASTERISK_DECIMAL;
-                    else if (isImmediate)
-                        r1 = TokenType::IMMEDIATE_DECIMAL;
-                    else
-                        r1 = TokenType::DECIMAL;
-                    r2 = data;
-                break;
+            value.assign("%");
+            value.append(canonical);
+            if (half)
+                value.push_back(half);
+            return TokenType::REGISTER_DIRECT;
 
-                // literal hexadecimal
-                case 9:
-                    if (isAsterisk)
-                        r1 = TokenType::ASTERISK_HEXADECIMAL;
-                    else if (isImmediate)
-                        r1 = TokenType::IMMEDIATE_HEXADECIMAL;
-                    else
-                        r1 = TokenType::HEXADECIMAL;
-                    r2 = data;
+        // pc relative or register indirect
+        case LexerState::STATE_PARENTHESIS_CLOSED:
+            if (!parseRegister(data, parenthesis + 2, data.size() - 1, canonical, half))
                 break;
 
-                // register direct
-                case 10:
-                    r1 = TokenType::REGISTER_DIRECT;
-                    r2 = data;
-                break;
+            value.resize(parenthesis + 2);
+            value.append(canonical);
+            if (half)
+                value.push_back(half);
+            value.push_back(')');
 
-                // pc relative
-                case 11:
-                    r1 = TokenType::PC_RELATIVE;
-                    r2 = data;
-                break;	
+            // only symbol(%r7) is pc relative, literal offset is ordinary register indirect
+            if (canonical == registerNames[7] && half == 0 && parenthesis > 0 && transitions.table[STATE_START][characterClasses.table[(uint8_t)data[0]]] == STATE_IDENTIFIER)
+                return TokenType::PC_RELATIVE;
 
-                // register indirect
-                case 12:
-                    r1 = TokenType::REGISTER_INDIRECT;
-                    r2 = data;
-                break;
+            return TokenType::REGISTER_INDIRECT;
 
-            }
+        default:
+        break;
+
+    }
+
+    return TokenType::INVALID;
+}
+
+void Token::decodeRegister(size_t begin, size_t end)
+{
+    // value is canonical here: %r0 - %r7 or %r15, optionally followed by h or l
+    if (value[end - 1] == 'h' || value[end - 1] == 'l')
+    {
+        operand.half = value[end - 1] == 'h' ? HALF_HIGH : HALF_LOW;
+        end--;
+    }
+
+    operand.registerNumber = 0;
+    for (size_t i = begin + 2; i < end; i++)
+        operand.registerNumber = operand.registerNumber * 10 + (value[i] - '0');
+}
+
+void Token::decodeOffset(size_t begin, size_t end, StringPool* strings)
+{
+    char first = value[begin];
+
+    if (first >= 'a' && first <= 'z')
+    {
+        operand.offsetKind = OFFSET_SYMBOL;
+        if (strings != nullptr)
+            operand.symbol = strings->intern(string_view(value).substr(begin, end - begin));
+        return;
+    }
+
+    // negative decimal literal wraps around, like the unsigned conversion did
+    bool negative = first == '-';
+    if (first == '-' || first == '+')
+        begin++;
 
-            return Token(r1, r2);
+    bool hexadecimal = end - begin > 2 && value[begin] == '0' && value[begin + 1] == 'x';
+    if (hexadecimal)
+        begin += 2;
 
+    unsigned long literal = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        char c = value[i];
+        unsigned digit = c <= '9' ? c - '0' : c - 'a' + 10;
+        literal = literal * (hexadecimal ? 16 : 10) + digit;
+    }
+
+    operand.offsetKind = OFFSET_LITERAL;
+    operand.value = negative ? 0 - literal : literal;
+}
+
+void Token::decodeOperand(StringPool* strings)
+{
+    switch (type)
+    {
+        case TokenType::ASTERISK_SYMBOL:
+        case TokenType::ASTERISK_DECIMAL:
+        case TokenType::ASTERISK_HEXADECIMAL:
+            operand.asterisk = true;
+            operand.mode = MODE_VALUE;
+            decodeOffset(0, value.size(), strings);
+        break;
+
+        case TokenType::IMMEDIATE_SYMBOL:
+        case TokenType::IMMEDIATE_DECIMAL:
+        case TokenType::IMMEDIATE_HEXADECIMAL:
+            operand.immediate = true;
+            operand.mode = MODE_VALUE;
+            decodeOffset(0, value.size(), strings);
+        break;
+
+        case TokenType::SYMBOL:
+        case TokenType::DECIMAL:
+        case TokenType::HEXADECIMAL:
+            operand.mode = MODE_VALUE;
+            decodeOffset(0, value.size(), strings);
+        break;
+
+        case TokenType::REGISTER_DIRECT:
+            operand.mode = MODE_REGISTER_DIRECT;
+            decodeRegister(0, value.size());
+        break;
+
+        case TokenType::REGISTER_INDIRECT:
+        case TokenType::PC_RELATIVE:
+        {
+            size_t parenthesis = value.find('(');
+
+            operand.mode = type == TokenType::PC_RELATIVE ? MODE_PC_RELATIVE : MODE_REGISTER_INDIRECT;
+            decodeRegister(parenthesis + 1, value.size() - 1);
+
+            if (parenthesis > 0)
+                decodeOffset(0, parenthesis, strings);
         }
+        break;
+
+        default:
+        break;
+    }
+}
+
+Token Token::parse(string_view str, unsigned long line, bool recursive, StringPool* strings) {
+
+    Token token;
+    token.lex(str, line, recursive, strings);
+    return token;
 
-        i++;
+}
+
+void Token::lex(string_view str, unsigned long line, bool recursive, StringPool* strings) {
+
+    operand = Operand();
+
+    if (str.size() == 0)
+    {
+        type = TokenType::INVALID;
+        value.clear();
+        return;
+    }
 
+    bool isImmediate = false;
+    bool isAsterisk = false;
+    size_t begin = 0;
+
+    if (str[0] == PREFIX_ASTERISK)
+    {
+        isAsterisk = true;
+        begin = 1;
+    }
+    else if (str[0] == PREFIX_IMMEDIATE)
+    {
+        isImmediate = true;
+        begin = 1;
+    }
+
+    string_view data = str.substr(begin);
+    size_t parenthesis;
+
+    LexerState state = scan(data, parenthesis);
+    type = classify(data, state, parenthesis, value, isAsterisk, isImmediate);
+
+    // source text is never rewritten, names are folded to lower case only here
+    if (type != TokenType::INVALID)
+    {
+        for (char& c : value)
+            c = toLower(c);
+
+        decodeOperand(strings);
+        return;
     }
 
     if (recursive)
     {
-        char* duplicate = strdup(str.c_str());
-        char* token = strtok(duplicate, ARITHMETIC_DELIMITER);
+        size_t i = 0;
+        Token part;
 
-        while (token != NULL)
+        while (i < str.size())
         {
-            Token t = parse(string(token), line, false);
+            if (str[i] == '+' || str[i] == '-')
+            {
+                i++;
+                continue;
+            }
 
-            if (
-                t.getType() != TokenType::IMMEDIATE_DECIMAL &&
-                t.getType() != TokenType::DECIMAL &&
-                t.getType() != TokenType::IMMEDIATE_HEXADECIMAL && 
-                t.getType() != TokenType::HEXADECIMAL && 
-                t.getType() != TokenType::IMMEDIATE_SYMBOL &&
-                t.getType() != TokenType::SYMBOL
-            )
-                throw AssemblyException("Unable to parse '" + str + "'.", line);
+            size_t j = i;
+            while (j < str.size() && str[j] != '+' && str[j] != '-')
+                j++;
 
-            token = strtok(NULL, ARITHMETIC_DELIMITER);
+            part.lex(str.substr(i, j - i), line, false);
 
+            if (!isArithmeticOperand(part.getType()))
+                throw AssemblyException("Unable to parse '" + string(str) + "'.", line);
+
+            i = j;
         }
 
-        delete duplicate;
+        type = TokenType::ARITHMETIC_EXPRESSION;
+        value.assign(str.data(), str.size());
+
+        for (char& c : value)
+            c = toLower(c);
+
+        return;
 
-        return Token(TokenType::ARITHMETIC_EXPRESSION, str);
-        
     }
 
-    throw AssemblyException("Unable to parse '" + str + "'.", line);
-    
-}
\ No newline at end of file
+    throw AssemblyException("Unable to parse '" + string(str) + "'.", line);
+
+}
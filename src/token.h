@@ -1,43 +1,107 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#define NUMBER_OF_PARSERS 13
-#define ARITHMETIC_DELIMITER "+-"
+#define PREFIX_ASTERISK '*'
+#define PREFIX_IMMEDIATE '$'
 
 #include <iostream>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <stdint.h>
 #include "enums.h"
 using namespace std;
 
-static const regex parsers[NUMBER_OF_PARSERS] = {
-
-    regex("^\\.(global|extern)$"),
-
-    regex("^([a-zA-Z][a-zA-Z0-9_]*):$"),
-
-    regex("^\\.section$"),
-
-    regex("^\\.(byte|equ|skip|word)$"),
-
-    regex("^(halt|ret|iret|int|jmp|jeq|jne|jgt|call|(not|push|pop|xchg|mov|add|sub|mul|div|cmp|and|or|xor|test|shl|shr)(b|w){0,1})$"),	
-
-    regex("^.end$"),
-            
-    regex("^(\\+|\\-){1}$"),
-
-    regex("^[a-zA-Z][a-zA-Z0-9_]*$"), 
-
-    regex("^(\\-|\\+){0,1}[0-9]+$"), 
+/*
+    Lexer is a table driven DFA. Every byte of the operand is mapped to one of
+    the character classes below and the next state is read from the transition
+    table, so operand is classified in one pass over its bytes. Accepting state
+    determines the token type; register names, mnemonics and dot keywords are
+    checked only once the whole token is consumed.
+*/
+
+/*
+    Instruction operands are decoded once, when the token is made, into the
+    record below; sizing and encoding read its fields and never look at the
+    operand text again.
+*/
+
+enum OperandMode : uint8_t
+{
+    MODE_NONE,              // not an operand
+    MODE_VALUE,             // literal or symbol, optionally with $ or *
+    MODE_REGISTER_DIRECT,   // %rX
+    MODE_REGISTER_INDIRECT, // (%rX) and offset(%rX)
+    MODE_PC_RELATIVE        // symbol(%r7)
+};
 
-    regex("^0x[0-9a-fA-F]{1,}$"),
+enum RegisterHalf : uint8_t
+{
+    HALF_NONE,
+    HALF_LOW,
+    HALF_HIGH
+};
 
-    regex("^%r([0-7]|15)(h|l){0,1}$"),
+enum OffsetKind : uint8_t
+{
+    OFFSET_NONE,
+    OFFSET_LITERAL,
+    OFFSET_SYMBOL
+};
 
-    regex("^[a-zA-Z][a-zA-Z0-9_]*\\(%r7\\)$"),
+struct Operand
+{
+    OperandMode mode = MODE_NONE;
+    uint8_t registerNumber = 0;
+    RegisterHalf half = HALF_NONE;
+    OffsetKind offsetKind = OFFSET_NONE;
+    bool immediate = false;
+    bool asterisk = false;
+    unsigned long value = 0;          // literal offset or value
+    unsigned long symbol = -1;        // atom of the symbol, if the lexer was given a string pool
+};
 
-    regex("^([a-zA-Z][a-zA-Z0-9_]*|(\\-|\\+){0,1}[0-9]+|0x[0-9a-fA-F]{1,}|)\\(%r([0-7]|15)(h|l){0,1}\\)$")
+class StringPool;
+
+enum CharacterClass : uint8_t
+{
+    CLASS_OTHER,
+    CLASS_LETTER,
+    CLASS_HEX_LETTER,
+    CLASS_X,
+    CLASS_ZERO,
+    CLASS_DIGIT,
+    CLASS_UNDERSCORE,
+    CLASS_DOT,
+    CLASS_COLON,
+    CLASS_SIGN,
+    CLASS_PERCENT,
+    CLASS_LEFT_PARENTHESIS,
+    CLASS_RIGHT_PARENTHESIS,
+
+    NUMBER_OF_CLASSES
+};
 
+enum LexerState : uint8_t
+{
+    STATE_REJECT,
+    STATE_START,
+    STATE_DOT,
+    STATE_DOT_WORD,
+    STATE_IDENTIFIER,
+    STATE_LABEL,
+    STATE_SIGN,
+    STATE_ZERO,
+    STATE_DECIMAL,
+    STATE_HEX_PREFIX,
+    STATE_HEXADECIMAL,
+    STATE_PERCENT,
+    STATE_REGISTER,
+    STATE_PARENTHESIS,
+    STATE_PARENTHESIS_PERCENT,
+    STATE_PARENTHESIS_REGISTER,
+    STATE_PARENTHESIS_CLOSED,
+
+    NUMBER_OF_STATES
 };
 
 class Token {
@@ -48,15 +112,32 @@ public:
     Token(TokenType type, string value) : type(type), value(value) {}
 
     TokenType getType() const;
-    string getValue() const;
+    const string& getValue() const;
+    const Operand& getOperand() const { return operand; }
 
-    static Token parse(string data, unsigned long line, bool recursive);
+    // symbols of instruction operands are interned into strings, if given
+    static Token parse(string_view data, unsigned long line, bool recursive, StringPool* strings = nullptr);
+
+    // same as parse, but into this token, so storage of its value is reused
+    void lex(string_view data, unsigned long line, bool recursive, StringPool* strings = nullptr);
 
 private:
 
-    TokenType type;
+    static LexerState scan(string_view data, size_t& parenthesis);
+    static bool parseRegister(string_view data, size_t begin, size_t end, const char*& canonical, char& half);
+    static TokenType classify(string_view data, LexerState state, size_t parenthesis, string& value, bool isAsterisk, bool isImmediate);
+
+    static bool isMnemonic(string_view data);
+    static bool isArithmeticOperand(TokenType type);
+
+    void decodeOperand(StringPool* strings);
+    void decodeRegister(size_t begin, size_t end);
+    void decodeOffset(size_t begin, size_t end, StringPool* strings);
+
+    TokenType type = TokenType::INVALID;
     string value;
+    Operand operand;
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,18 @@
+.global start
+.extern putc
+.section text:
+start:
+mov $table, %r1
+mov table(%pc), %r2
+mov entry, %r3
+jmp loop
+loop:
+call putc
+jmp *2(%r1)
+halt
+.section data:
+table: .word start, loop
+entry: .word 0x10
+.section bss:
+.skip 4
+.end
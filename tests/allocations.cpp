@@ -0,0 +1,108 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../src/assembler.h"
+#include "../src/exceptions.h"
+#include "counting.h"
+
+using namespace std;
+
+/*
+    Allocation check of the main assembly loop. Both inputs define the same
+    symbols, but the larger one repeats the lines between the labels four
+    times, and every heap allocation made while assembling them is counted.
+    Each new symbol costs a node in the string pool and in the symbol table;
+    a line costs nothing once tables and buffers have grown, so the larger
+    input may take only the few more allocations its buffers need to double.
+*/
+
+#define BLOCKS 500
+#define REPEAT_SMALL 1
+#define REPEAT_LARGE 4
+#define LINES_PER_ALLOCATION 100 // the larger input may take one more allocation per this many lines
+
+// every kind of line the pass handles, labels are made unique by the block number
+static size_t writeInput(const string& path, size_t repeat)
+{
+    ofstream input(path);
+    size_t lines = 2;
+
+    input << ".global b0\n.section text:\n";
+
+    for (size_t i = 0; i < BLOCKS; i++)
+    {
+        string n = to_string(i);
+
+        input << "b" << n << ":\n";
+
+        for (size_t j = 0; j < repeat; j++)
+        {
+            input <<
+                "mov f" << n << "(%pc), %r1\n"
+                "add $" << n << ", %r2\n"
+                "movb %r1l, f" << n << "\n"
+                "mov *d" << n << ", %r3\n"
+                "jmp *%r3\n"
+                "push (%r4)\n"
+                "pop 2(%r5)\n"
+                "jeq f" << n << "\n"
+                ".word b" << n << ", 0x10\n"
+                ".byte 1, 2\n"
+                ".skip 2\n";
+
+            lines += 11;
+        }
+
+        input << "d" << n << ": .word 0\nf" << n << ": halt\n";
+
+        lines += 3;
+    }
+
+    input << ".end\n";
+
+    return lines + 1;
+}
+
+static size_t countAllocations(const string& input, const string& output)
+{
+    allocations = 0;
+
+    Assembler* assembler = new Assembler(input, output);
+    assembler->generate();
+    delete assembler;
+
+    return allocations;
+}
+
+int main()
+{
+    try
+    {
+        size_t smallLines = writeInput("allocations_small.s", REPEAT_SMALL);
+        size_t largeLines = writeInput("allocations_large.s", REPEAT_LARGE);
+
+        size_t small = countAllocations("allocations_small.s", "allocations.o");
+        size_t large = countAllocations("allocations_large.s", "allocations.o");
+
+        remove("allocations_small.s");
+        remove("allocations_large.s");
+        remove("allocations.o");
+
+        cout << "Allocations: " << small << " for " << smallLines << " lines, " << large << " for " << largeLines << " lines" << endl;
+
+        if (large > small && (large - small) * LINES_PER_ALLOCATION > largeLines - smallLines)
+        {
+            cout << "Allocations grow with the number of lines" << endl;
+            return 1;
+        }
+
+        return 0;
+    }
+    catch (AssemblyException& ex)
+    {
+        cout << ex.what() << endl;
+    }
+
+    return 1;
+}
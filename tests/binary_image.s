@@ -0,0 +1,12 @@
+.section boot:
+mov $0x10, %r6
+call *handler(%pc)
+halt
+handler: .word code
+.section code:
+mov %r1, 0xFF00
+ret
+.section gap:
+.skip 3
+.byte 0xEE
+.end
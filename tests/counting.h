@@ -0,0 +1,36 @@
+#ifndef COUNTING_H
+#define COUNTING_H
+
+#include <new>
+#include <stdlib.h>
+
+using namespace std;
+
+/*
+    Replaces the global operator new and delete with ones that count every
+    heap allocation made by the program. Included by exactly one file of a
+    test or benchmark binary, which reads and resets allocations around the
+    code it measures.
+*/
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+
+    void* memory = malloc(size ? size : 1);
+
+    if (memory == nullptr)
+        throw bad_alloc();
+
+    return memory;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+#endif
@@ -0,0 +1,17 @@
+.global main, counter
+.extern print
+.section text:
+main:
+mov counter, %r1
+add $1, %r1
+mov %r1, counter
+mov message(%pc), %r2
+call print
+jne main
+jmp *%r3
+halt
+.section data:
+counter: .word 0
+message: .byte 0x48, 0x69, 0
+.word main
+.end
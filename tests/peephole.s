@@ -0,0 +1,31 @@
+.global start
+.section text:
+start:
+push %r1
+pop %r1
+mov %r2, %r2
+add %r3, %r4
+jmp next
+next:
+add $0, %r1
+cmp %r1, %r2
+jeq done
+push %r2
+back:
+pop %r2
+movb %r1l, %r1l
+movb %r1l, %r1h
+jmp back
+mov %r3, %r3
+mov %psw, %r1
+sub $0, %r1
+mov %r1, %r2
+push %sp
+pop %sp
+mov x(%pc), %r1
+jmp done
+done:
+halt
+.section data:
+x: .word done, next
+.end
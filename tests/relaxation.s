@@ -0,0 +1,16 @@
+.section text:
+mov next(%pc), %r1
+next:
+mov far(%pc), %r2
+mov chain(%pc), %r3
+mov skip(%pc), %r4
+chain:
+skip:
+mov zero(%r5), %r1
+mov table(%r5), %r2
+halt
+far: .word 0
+.section low:
+zero: .word 0x1234
+table: .word 0x5678
+.end